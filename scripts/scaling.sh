@@ -0,0 +1,33 @@
+#!/bin/bash
+
+# Generates synthetic graphs of growing size and correlation and contracts them.
+# Prints one line per run with the number of created shortcuts and the run time of multi-ch
+# (including loading and its query self-test).
+#
+# usage: scripts/scaling.sh <build dir> [topology] [percent]
+
+build=${1:-build}
+topology=${2:-road}
+percent=${3:-98}
+dim=$(grep -E "^GRAPH_DIM:" "$build/CMakeCache.txt" | cut -d= -f2)
+sizes=( 10000 40000 160000 )
+correlations=( 0.8 0 -0.8 )
+tmp=$(mktemp -d)
+
+echo -e "nodes\tcorrelation\tedges\tshortcuts\tmilliseconds"
+for size in ${sizes[@]}
+do
+    for correlation in ${correlations[@]}
+    do
+	graph="$tmp/graph.txt"
+	"$build/multi-gen" -t "$topology" -n "$size" -c "$correlation" -d "$dim" -w "$graph" 2> /dev/null
+	edges=$(sed -n '/^$/,$p' "$graph" | sed -n 4p)
+
+	start=$(date +%s%N)
+	final=$("$build/multi-ch$dim" -t "$graph" -p "$percent" | grep "Final graph" | grep -oE "[0-9,.]+ edges" | tr -dc '0-9')
+	end=$(date +%s%N)
+
+	echo -e "$size\t$correlation\t$edges\t$((final - edges))\t$(((end - start) / 1000000))"
+    done
+done
+rm -r "$tmp"
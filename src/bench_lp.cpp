@@ -0,0 +1,182 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "contractionLP.hpp"
+#include "costEnvelope.hpp"
+#include "glpk.h"
+#include "lpCorpus.hpp"
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+
+// Replays an LP corpus recorded with --record-lps against several solvers
+
+struct Solution {
+  bool feasible = false;
+  double delta = -1;
+};
+
+using Solver = std::function<Solution(const LpProblem&)>;
+
+// The multi_lp child process used while contracting
+Solver subprocessSolver()
+{
+  auto lp = std::make_shared<ContractionLp>();
+  return [lp](const LpProblem& problem) {
+    for (const auto& constraint : problem.constraints) {
+      lp->addConstraint(constraint);
+    }
+    Solution s {};
+    s.feasible = lp->solve();
+    s.delta = lp->delta();
+    return s;
+  };
+}
+
+// The LP of multi_lp without the pipes in between
+Solution glpkInProcess(const LpProblem& problem)
+{
+  const int varCount = Cost::dim;
+  std::unique_ptr<glp_prob, void (*)(glp_prob*)> lp(glp_create_prob(), glp_delete_prob);
+  glp_set_obj_dir(lp.get(), GLP_MAX);
+  glp_add_cols(lp.get(), varCount + 1);
+  for (int i = 1; i <= varCount; ++i) {
+    glp_set_col_bnds(lp.get(), i, GLP_DB, 0, 1);
+  }
+  const int deltaCol = varCount + 1;
+  glp_set_col_bnds(lp.get(), deltaCol, GLP_LO, 0, 0);
+  glp_set_obj_coef(lp.get(), deltaCol, 1);
+
+  std::vector<int> ind(varCount + 2);
+  std::vector<double> val(varCount + 2, 1);
+  for (int i = 0; i <= varCount + 1; ++i) {
+    ind[i] = i;
+  }
+  int row = glp_add_rows(lp.get(), 1);
+  glp_set_row_bnds(lp.get(), row, GLP_FX, 1, 1);
+  glp_set_mat_row(lp.get(), row, varCount, ind.data(), val.data());
+  for (const auto& constraint : problem.constraints) {
+    row = glp_add_rows(lp.get(), 1);
+    std::copy(constraint.begin(), constraint.end(), val.begin() + 1);
+    val[deltaCol] = -1;
+    glp_set_row_bnds(lp.get(), row, GLP_LO, 0, 0);
+    glp_set_mat_row(lp.get(), row, varCount + 1, ind.data(), val.data());
+  }
+
+  glp_smcp params;
+  glp_init_smcp(&params);
+  params.presolve = GLP_ON;
+  params.msg_lev = GLP_MSG_OFF;
+  Solution s {};
+  if (glp_simplex(lp.get(), &params) == 0) {
+    int status = glp_get_status(lp.get());
+    s.feasible = status == GLP_OPT || status == GLP_FEAS;
+  }
+  if (s.feasible) {
+    s.delta = glp_get_col_prim(lp.get(), deltaCol);
+  }
+  return s;
+}
+
+// Exact solver on the CostEnvelope of the config sweep: delta is the highest point of the
+// polytope below all constraints, with delta >= 0 as its lower bound
+Solution envelope(const LpProblem& problem)
+{
+  Solution s {};
+  // Without constraints delta is unbounded, which GLPK does not report as optimal either
+  if (problem.constraints.empty()) {
+    return s;
+  }
+  double highest = 0;
+  for (const auto& c : problem.constraints) {
+    highest = std::max(highest, *std::max_element(c.begin(), c.end()));
+  }
+  CostEnvelope polytope { 0, highest + 1 };
+  for (const auto& c : problem.constraints) {
+    polytope.add(c);
+  }
+  if (auto best = polytope.maximum()) {
+    s.feasible = true;
+    s.delta = best->cost;
+  }
+  return s;
+}
+
+void bench(const std::string& name, const Solver& solver, const std::vector<LpProblem>& problems)
+{
+  size_t solved = 0;
+  size_t feasibility = 0;
+  size_t delta = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const auto& problem : problems) {
+    auto s = solver(problem);
+    ++solved;
+    if (s.feasible != problem.feasible) {
+      ++feasibility;
+    } else if (s.feasible
+        && std::abs(s.delta - problem.delta) > 1e-6 * std::max(1.0, std::abs(problem.delta))) {
+      ++delta;
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(end - start).count();
+  std::cout << name << ": " << solved << " problems in " << seconds * 1000 << "ms, "
+            << (seconds > 0 ? solved / seconds : 0) << " solves/s, " << feasibility
+            << " feasibility and " << delta << " delta disagreements" << '\n';
+}
+
+namespace po = boost::program_options;
+int main(int argc, char* argv[])
+{
+  std::string corpusFileName {};
+
+  po::options_description options { "options" };
+
+  // clang-format off
+  options.add_options()
+    ("help,h", "Prints help message")
+    ("corpus,c", po::value<std::string>(&corpusFileName), "LP corpus written by multi-ch --record-lps");
+  // clang-format on
+
+  po::variables_map vm {};
+  po::store(po::parse_command_line(argc, argv, options), vm);
+  po::notify(vm);
+
+  if (vm.count("help") > 0 || vm.count("corpus") == 0) {
+    std::cout << options << '\n';
+    return vm.count("help") > 0 ? 0 : 1;
+  }
+
+  auto problems = LpCorpus::read(corpusFileName);
+  size_t constraints = 0;
+  size_t feasible = 0;
+  for (const auto& problem : problems) {
+    constraints += problem.constraints.size();
+    feasible += problem.feasible ? 1 : 0;
+  }
+  std::cout << "Read " << problems.size() << " problems of dimension " << Cost::dim << " with "
+            << static_cast<double>(constraints) / std::max<size_t>(1, problems.size())
+            << " constraints on average, " << feasible << " feasible" << '\n';
+
+  bench("glpk subprocess", subprocessSolver(), problems);
+  bench("glpk in process", glpkInProcess, problems);
+  bench("cost envelope", envelope, problems);
+  return 0;
+}
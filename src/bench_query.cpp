@@ -0,0 +1,140 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "dijkstra.hpp"
+#include "graph_loading.hpp"
+#include "graphml.hpp"
+#include <algorithm>
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+
+// Measures the latency of CH queries on a contracted graph with and without the parallel search
+
+struct Query {
+  NodePos from;
+  NodePos to;
+  Config config;
+};
+
+struct Latencies {
+  std::vector<double> micros;
+  std::vector<double> costs;
+};
+
+Latencies run(Dijkstra& d, const std::vector<Query>& queries)
+{
+  Latencies result;
+  for (const auto& q : queries) {
+    auto start = std::chrono::steady_clock::now();
+    auto route = d.findBestRoute(q.from, q.to, q.config);
+    auto end = std::chrono::steady_clock::now();
+    result.micros.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+    result.costs.push_back(route ? route->costs * q.config : -1);
+  }
+  return result;
+}
+
+void report(const std::string& name, Latencies latencies, const Latencies& reference)
+{
+  size_t disagreements = 0;
+  for (size_t i = 0; i < latencies.costs.size(); ++i) {
+    if (std::abs(latencies.costs[i] - reference.costs[i])
+        > COST_ACCURACY * std::max(1.0, reference.costs[i])) {
+      ++disagreements;
+    }
+  }
+  auto& micros = latencies.micros;
+  std::sort(micros.begin(), micros.end());
+  double sum = 0;
+  for (auto value : micros) {
+    sum += value;
+  }
+  auto percentile = [&micros](double p) {
+    return micros.empty() ? 0 : micros[static_cast<size_t>(p * (micros.size() - 1))];
+  };
+  std::cout << name << ": " << sum / std::max<size_t>(1, micros.size()) << "us mean, "
+            << percentile(0.5) << "us median, " << percentile(0.99) << "us p99, "
+            << disagreements << " cost disagreements" << '\n';
+}
+
+namespace po = boost::program_options;
+int main(int argc, char* argv[])
+{
+  std::string graphFileName {};
+  size_t queryCount;
+  size_t seed;
+
+  po::options_description options { "options" };
+
+  // clang-format off
+  options.add_options()
+    ("help,h", "Prints help message")
+    ("text,t", po::value<std::string>(&graphFileName), "Contracted graph written by multi-ch -w")
+    ("zi", "input text file is gzipped")
+    ("queries,q", po::value<size_t>(&queryCount)->default_value(1000), "Number of random queries")
+    ("seed,s", po::value<size_t>(&seed)->default_value(42), "Seed of the random queries");
+  // clang-format on
+
+  po::variables_map vm {};
+  po::store(po::parse_command_line(argc, argv, options), vm);
+  po::notify(vm);
+
+  if (vm.count("help") > 0 || vm.count("text") == 0) {
+    std::cout << options << '\n';
+    return vm.count("help") > 0 ? 0 : 1;
+  }
+
+  Graph g = loadGraphFromTextFile(graphFileName, vm.count("zi") > 0);
+  if (g.getNodeCount() == 0) {
+    std::cerr << "The graph has no nodes" << '\n';
+    return 1;
+  }
+
+  std::mt19937 random { static_cast<std::mt19937::result_type>(seed) };
+  std::uniform_int_distribution<size_t> node(0, g.getNodeCount() - 1);
+  std::uniform_real_distribution<double> weight(0, 1);
+  std::vector<Query> queries;
+  for (size_t i = 0; i < queryCount; ++i) {
+    std::vector<double> values(Cost::dim);
+    double sum = 0;
+    for (auto& value : values) {
+      value = weight(random);
+      sum += value;
+    }
+    for (auto& value : values) {
+      value /= sum;
+    }
+    queries.push_back(Query { NodePos { node(random) }, NodePos { node(random) }, values });
+  }
+
+  Dijkstra sequential = g.createDijkstra();
+  Dijkstra parallel = g.createDijkstra();
+  parallel.searchInParallel(true);
+  // Warm up caches and start the helper thread before measuring
+  run(sequential, { queries.front() });
+  run(parallel, { queries.front() });
+
+  auto reference = run(sequential, queries);
+  std::cout << "Ran " << queries.size() << " queries on " << g.getNodeCount() << " nodes with "
+            << std::thread::hardware_concurrency() << " hardware threads" << '\n';
+  report("sequential", reference, reference);
+  report("parallel", run(parallel, queries), reference);
+  return 0;
+}
@@ -0,0 +1,401 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "graphml.hpp"
+#include "ndijkstra.hpp"
+#include "witnessTrace.hpp"
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <queue>
+
+// Replays a witness trace recorded with --record-witness against several search implementations
+
+struct SearchResult {
+  bool found = false;
+  double cost = 0;
+  size_t settled = 0;
+};
+
+double costOf(const Cost& cost, const std::array<double, Cost::dim>& config)
+{
+  double sum = 0;
+  for (size_t i = 0; i < Cost::dim; ++i) {
+    sum += cost.values[i] * config[i];
+  }
+  return sum;
+}
+
+// Compressed adjacency array of a snapshot with the nodes renumbered in the given order
+class FlatGraph {
+  public:
+  struct FlatEdge {
+    size_t end;
+    Cost cost;
+  };
+
+  FlatGraph(const GraphSnapshot& snapshot, const std::vector<size_t>& order)
+      : position(snapshot.nodeCount)
+  {
+    for (size_t i = 0; i < order.size(); ++i) {
+      position[order[i]] = i;
+    }
+    std::vector<size_t> firstEdge(snapshot.nodeCount + 1, 0);
+    for (const auto& e : snapshot.edges) {
+      ++firstEdge[e.begin + 1];
+    }
+    for (size_t i = 0; i < snapshot.nodeCount; ++i) {
+      firstEdge[i + 1] += firstEdge[i];
+    }
+    offsets.push_back(0);
+    for (auto node : order) {
+      for (size_t i = firstEdge[node]; i < firstEdge[node + 1]; ++i) {
+        const auto& e = snapshot.edges[i];
+        edges.push_back(FlatEdge { position[e.end], e.cost });
+      }
+      offsets.push_back(edges.size());
+    }
+  }
+
+  size_t nodeCount() const { return position.size(); }
+
+  std::vector<size_t> position;
+  std::vector<size_t> offsets;
+  std::vector<FlatEdge> edges;
+};
+
+std::vector<size_t> inputOrder(const GraphSnapshot& snapshot)
+{
+  std::vector<size_t> order(snapshot.nodeCount);
+  std::iota(order.begin(), order.end(), 0);
+  return order;
+}
+
+// Nodes close in the graph get close numbers, so a search touches fewer cache lines
+std::vector<size_t> bfsOrder(const GraphSnapshot& snapshot)
+{
+  FlatGraph g { snapshot, inputOrder(snapshot) };
+  std::vector<bool> visited(snapshot.nodeCount, false);
+  std::vector<size_t> order;
+  order.reserve(snapshot.nodeCount);
+  for (size_t root = 0; root < snapshot.nodeCount; ++root) {
+    if (visited[root]) {
+      continue;
+    }
+    visited[root] = true;
+    order.push_back(root);
+    for (size_t next = order.size() - 1; next < order.size(); ++next) {
+      size_t node = order[next];
+      for (size_t i = g.offsets[node]; i < g.offsets[node + 1]; ++i) {
+        if (!visited[g.edges[i].end]) {
+          visited[g.edges[i].end] = true;
+          order.push_back(g.edges[i].end);
+        }
+      }
+    }
+  }
+  return order;
+}
+
+// Priority queue with lazy deletion like NormalDijkstra uses
+class LazyBinaryHeap {
+  public:
+  void clear(size_t /*nodeCount*/) { heap = Queue {}; }
+  bool empty() const { return heap.empty(); }
+  void push(size_t node, double cost) { heap.emplace(cost, node); }
+  std::pair<double, size_t> pop()
+  {
+    auto top = heap.top();
+    heap.pop();
+    return top;
+  }
+
+  private:
+  using Elem = std::pair<double, size_t>;
+  using Queue = std::priority_queue<Elem, std::vector<Elem>, std::greater<>>;
+  Queue heap;
+};
+
+// Heap with four children per node which updates entries instead of inserting them again
+class DecreaseKeyHeap {
+  public:
+  void clear(size_t nodeCount)
+  {
+    for (const auto& elem : heap) {
+      index[elem.second] = none;
+    }
+    heap.clear();
+    index.resize(nodeCount, none);
+  }
+  bool empty() const { return heap.empty(); }
+  void push(size_t node, double cost)
+  {
+    size_t pos = index[node];
+    if (pos == none) {
+      pos = heap.size();
+      heap.emplace_back(cost, node);
+    } else {
+      heap[pos].first = cost;
+    }
+    siftUp(pos);
+  }
+  std::pair<double, size_t> pop()
+  {
+    auto top = heap.front();
+    index[top.second] = none;
+    heap.front() = heap.back();
+    heap.pop_back();
+    if (!heap.empty()) {
+      siftDown(0);
+    }
+    return top;
+  }
+
+  private:
+  static constexpr size_t arity = 4;
+  static constexpr size_t none = std::numeric_limits<size_t>::max();
+
+  void place(size_t pos, std::pair<double, size_t> elem)
+  {
+    heap[pos] = elem;
+    index[elem.second] = pos;
+  }
+  void siftUp(size_t pos)
+  {
+    auto elem = heap[pos];
+    while (pos > 0 && heap[(pos - 1) / arity].first > elem.first) {
+      place(pos, heap[(pos - 1) / arity]);
+      pos = (pos - 1) / arity;
+    }
+    place(pos, elem);
+  }
+  void siftDown(size_t pos)
+  {
+    auto elem = heap[pos];
+    while (true) {
+      size_t first = pos * arity + 1;
+      if (first >= heap.size()) {
+        break;
+      }
+      size_t best = first;
+      for (size_t i = first + 1; i < std::min(first + arity, heap.size()); ++i) {
+        if (heap[i].first < heap[best].first) {
+          best = i;
+        }
+      }
+      if (heap[best].first >= elem.first) {
+        break;
+      }
+      place(pos, heap[best]);
+      pos = best;
+    }
+    place(pos, elem);
+  }
+
+  std::vector<std::pair<double, size_t>> heap;
+  std::vector<size_t> index;
+};
+
+// Plain Dijkstra on a flat graph until the target is settled
+template <class Heap> class FlatSearch {
+  public:
+  FlatSearch(const FlatGraph& g)
+      : g(g)
+      , cost(g.nodeCount(), std::numeric_limits<double>::max())
+  {
+  }
+
+  SearchResult operator()(const WitnessSearch& s)
+  {
+    for (auto node : touched) {
+      cost[node] = std::numeric_limits<double>::max();
+    }
+    touched.clear();
+    heap.clear(g.nodeCount());
+
+    size_t from = g.position[s.in.end];
+    size_t to = g.position[s.out.end];
+    SearchResult result {};
+    cost[from] = 0;
+    touched.push_back(from);
+    heap.push(from, 0);
+    while (!heap.empty()) {
+      auto [pathCost, node] = heap.pop();
+      if (node == to) {
+        result.found = true;
+        result.cost = pathCost;
+        return result;
+      }
+      if (pathCost > cost[node]) {
+        continue;
+      }
+      ++result.settled;
+      for (size_t i = g.offsets[node]; i < g.offsets[node + 1]; ++i) {
+        const auto& edge = g.edges[i];
+        double nextCost = pathCost + costOf(edge.cost, s.config);
+        if (nextCost < cost[edge.end]) {
+          if (cost[edge.end] == std::numeric_limits<double>::max()) {
+            touched.push_back(edge.end);
+          }
+          cost[edge.end] = nextCost;
+          heap.push(edge.end, nextCost);
+        }
+      }
+    }
+    return result;
+  }
+
+  private:
+  const FlatGraph& g;
+  std::vector<double> cost;
+  std::vector<size_t> touched;
+  Heap heap;
+};
+
+// The search used while contracting on a graph rebuilt from the snapshot
+class ContractionSearch {
+  public:
+  ContractionSearch(const GraphSnapshot& snapshot)
+      : g(createGraph(snapshot))
+      , d(g->createNormalDijkstra())
+  {
+  }
+
+  SearchResult operator()(const WitnessSearch& s)
+  {
+    Config config { std::vector<double>(s.config.begin(), s.config.end()) };
+    auto route = d.findBestRoute(NodePos { s.in.end }, NodePos { s.out.end }, config);
+    SearchResult result {};
+    result.found = route.has_value();
+    result.cost = route ? costOf(route->costs, s.config) : 0;
+    result.settled = d.settledNodes();
+    return result;
+  }
+
+  private:
+  static std::unique_ptr<Graph> createGraph(const GraphSnapshot& snapshot)
+  {
+    std::vector<Node> nodes;
+    nodes.reserve(snapshot.nodeCount);
+    for (size_t i = 0; i < snapshot.nodeCount; ++i) {
+      nodes.emplace_back(std::to_string(i), NodeId { i });
+    }
+    std::vector<Edge> edges;
+    edges.reserve(snapshot.edges.size());
+    for (const auto& e : snapshot.edges) {
+      Edge edge { NodeId { e.begin }, NodeId { e.end } };
+      edge.setCost(e.cost);
+      edges.push_back(std::move(edge));
+    }
+    return std::make_unique<Graph>(std::move(nodes), std::move(edges));
+  }
+
+  std::unique_ptr<Graph> g;
+  NormalDijkstra d;
+};
+
+struct Statistics {
+  size_t searches = 0;
+  size_t settled = 0;
+  size_t disagreements = 0;
+  double seconds = 0;
+};
+
+template <class Search>
+void replay(Statistics& stats, Search search, const std::vector<WitnessSearch>& searches,
+    size_t repeat)
+{
+  auto start = std::chrono::steady_clock::now();
+  for (size_t r = 0; r < repeat; ++r) {
+    for (const auto& s : searches) {
+      auto result = search(s);
+      ++stats.searches;
+      stats.settled += result.settled;
+      double expected = costOf(s.witness, s.config);
+      if (result.found != s.found
+          || (s.found
+              && std::abs(result.cost - expected) > COST_ACCURACY * std::max(1.0, expected))) {
+        ++stats.disagreements;
+      }
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  stats.seconds += std::chrono::duration<double>(end - start).count();
+}
+
+namespace po = boost::program_options;
+int main(int argc, char* argv[])
+{
+  std::string traceFileName {};
+  size_t repeat;
+
+  po::options_description options { "options" };
+
+  // clang-format off
+  options.add_options()
+    ("help,h", "Prints help message")
+    ("trace,t", po::value<std::string>(&traceFileName), "Witness trace written by multi-ch --record-witness")
+    ("repeat,r", po::value<size_t>(&repeat)->default_value(1), "Run every search this many times");
+  // clang-format on
+
+  po::variables_map vm {};
+  po::store(po::parse_command_line(argc, argv, options), vm);
+  po::notify(vm);
+
+  if (vm.count("help") > 0 || vm.count("trace") == 0) {
+    std::cout << options << '\n';
+    return vm.count("help") > 0 ? 0 : 1;
+  }
+
+  std::map<uint64_t, std::vector<WitnessSearch>> bySnapshot;
+  size_t found = 0;
+  for (const auto& search : WitnessTrace::read(traceFileName)) {
+    found += search.found ? 1 : 0;
+    bySnapshot[search.snapshot].push_back(search);
+  }
+
+  std::vector<std::string> names { "contraction search", "binary heap", "4-ary heap",
+    "binary heap, bfs layout", "4-ary heap, bfs layout" };
+  std::vector<Statistics> stats(names.size());
+  size_t searches = 0;
+  for (const auto& [id, snapshotSearches] : bySnapshot) {
+    auto snapshot
+        = WitnessTrace::readSnapshot(WitnessTrace::snapshotFileName(traceFileName, id));
+    FlatGraph input { snapshot, inputOrder(snapshot) };
+    FlatGraph bfs { snapshot, bfsOrder(snapshot) };
+    replay(stats[0], ContractionSearch { snapshot }, snapshotSearches, repeat);
+    replay(stats[1], FlatSearch<LazyBinaryHeap> { input }, snapshotSearches, repeat);
+    replay(stats[2], FlatSearch<DecreaseKeyHeap> { input }, snapshotSearches, repeat);
+    replay(stats[3], FlatSearch<LazyBinaryHeap> { bfs }, snapshotSearches, repeat);
+    replay(stats[4], FlatSearch<DecreaseKeyHeap> { bfs }, snapshotSearches, repeat);
+    searches += snapshotSearches.size();
+  }
+  std::cout << "Read " << searches << " searches of dimension " << Cost::dim << " on "
+            << bySnapshot.size() << " graph snapshots, " << found << " found a witness" << '\n';
+
+  for (size_t i = 0; i < names.size(); ++i) {
+    const auto& s = stats[i];
+    double count = std::max<size_t>(1, s.searches);
+    std::cout << names[i] << ": " << s.seconds * 1e6 / count << "us per search, "
+              << s.settled / count << " settled nodes on average, " << s.disagreements
+              << " disagreements" << '\n';
+  }
+  return 0;
+}
@@ -0,0 +1,148 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "dimension.hpp"
+#include "graph_dims.hpp"
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/program_options.hpp>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+// main.cpp is compiled once per dimension, each copy lives in its own namespace dim<n>
+#define DECLARE_RUN(d)                                                                             \
+  inline namespace dim##d {                                                                        \
+  int run(int argc, char* argv[]);                                                                 \
+  }
+MULTI_CH_GRAPH_DIMS(DECLARE_RUN)
+#undef DECLARE_RUN
+
+using Runner = int (*)(int, char*[]);
+
+#define RUNNER(d) { d, &dim##d::run },
+const std::vector<std::pair<size_t, Runner>> runners { MULTI_CH_GRAPH_DIMS(RUNNER) };
+#undef RUNNER
+
+// Reads the dimension line the same way Graph::createFromStream does
+std::optional<size_t> readDimension(const std::string& fileName, bool zipped)
+{
+  namespace iostr = boost::iostreams;
+  std::ifstream file { fileName };
+  if (!file) {
+    return {};
+  }
+  iostr::filtering_istream in;
+  if (zipped) {
+    in.push(iostr::gzip_decompressor());
+  }
+  in.push(file);
+
+  std::string line {};
+  std::getline(in, line);
+  while (in && !line.empty() && line.front() == '#') {
+    std::getline(in, line);
+  }
+  std::getline(in, line);
+  try {
+    return std::stoul(line);
+  } catch (std::exception& e) {
+    return {};
+  }
+}
+
+// Parses the dimension given with --dim, only plain decimal numbers are accepted
+std::optional<size_t> parseDimension(const std::string& value)
+{
+  if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos) {
+    return {};
+  }
+  try {
+    return std::stoul(value);
+  } catch (std::out_of_range& e) {
+    return {};
+  }
+}
+
+namespace po = boost::program_options;
+int main(int argc, char* argv[])
+{
+  std::optional<size_t> dim {};
+  std::string dimValue {};
+  std::string textFile {};
+
+  // Only the options needed to find the dimension, run() of that dimension parses all of them
+  po::options_description loading {};
+  // clang-format off
+  loading.add_options()
+    ("text,t", po::value<std::string>(&textFile))
+    ("multi,m", po::value<std::string>())
+    ("graphml,g", po::value<std::string>())
+    ("zi", "")
+    ("dim", po::value<std::string>(&dimValue));
+  // clang-format on
+
+  po::variables_map vm {};
+  try {
+    po::store(po::command_line_parser(argc, argv).options(loading).allow_unregistered().run(), vm);
+    po::notify(vm);
+  } catch (po::error& e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+  }
+
+  if (vm.count("dim") > 0) {
+    dim = parseDimension(dimValue);
+    if (!dim) {
+      std::cerr << "Invalid dimension '" << dimValue << "' given with --dim" << '\n';
+      return 1;
+    }
+  }
+
+  if (!dim) {
+    if (!textFile.empty()) {
+      dim = readDimension(textFile, vm.count("zi") > 0);
+      if (!dim) {
+        std::cerr << "Could not read the dimension of " << textFile << '\n';
+        return 1;
+      }
+    } else if (vm.count("multi") > 0) {
+      dim = multiFileDimension;
+    } else if (vm.count("graphml") > 0) {
+      std::cerr << "The dimension of graphml files has to be given with --dim" << '\n';
+      return 1;
+    } else {
+      // Nothing to load, any dimension prints the help message
+      return runners.front().second(argc, argv);
+    }
+  }
+
+  for (const auto& [runnerDim, runner] : runners) {
+    if (runnerDim == *dim) {
+      return runner(argc, argv);
+    }
+  }
+
+  std::cerr << "multi-ch is not built for dimension " << *dim << ", available are:";
+  for (const auto& runner : runners) {
+    std::cerr << ' ' << runner.first;
+  }
+  std::cerr << '\n' << "Add it to the GRAPH_DIMS cmake variable." << '\n';
+  return 1;
+}
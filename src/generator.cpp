@@ -0,0 +1,317 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/program_options.hpp>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Coordinates are generated in meters and mapped onto a small patch around Stuttgart
+const double baseLat = 48.0;
+const double baseLng = 9.0;
+const double metersPerDegree = 111320.0;
+
+struct GenNode {
+  double x;
+  double y;
+};
+
+struct GenEdge {
+  size_t source;
+  size_t dest;
+  std::vector<double> costs;
+};
+
+class GraphGenerator {
+  public:
+  GraphGenerator(size_t dim, double correlation, double spread, unsigned long seed)
+      : dim(dim)
+      , correlation(correlation)
+      , spread(spread)
+      , rand(seed)
+  {
+    if (correlation < -1 || correlation > 1) {
+      throw std::invalid_argument("correlation must be within [-1, 1]");
+    }
+  }
+
+  // Quadratic grid with 4-neighbourhood and slightly jittered node positions
+  void grid(size_t nodeCount, double spacing)
+  {
+    size_t side = std::max<size_t>(2, std::ceil(std::sqrt(nodeCount)));
+    std::uniform_real_distribution<double> jitter(-0.2 * spacing, 0.2 * spacing);
+    for (size_t y = 0; y < side; ++y) {
+      for (size_t x = 0; x < side; ++x) {
+        nodes.push_back(GenNode { x * spacing + jitter(rand), y * spacing + jitter(rand) });
+      }
+    }
+    for (size_t y = 0; y < side; ++y) {
+      for (size_t x = 0; x < side; ++x) {
+        size_t id = y * side + x;
+        if (x + 1 < side) {
+          addStreet(id, id + 1);
+        }
+        if (y + 1 < side) {
+          addStreet(id, id + side);
+        }
+      }
+    }
+  }
+
+  // Uniformly distributed points, connected to all points within the radius that yields the
+  // requested average degree
+  void geometric(size_t nodeCount, double spacing, double degree)
+  {
+    double side = std::sqrt(static_cast<double>(nodeCount)) * spacing;
+    double radius = std::sqrt(degree * side * side / (M_PI * nodeCount));
+    std::uniform_real_distribution<double> coord(0, side);
+    for (size_t i = 0; i < nodeCount; ++i) {
+      nodes.push_back(GenNode { coord(rand), coord(rand) });
+    }
+
+    size_t cellsPerSide = std::max<size_t>(1, side / radius);
+    double cellSize = side / cellsPerSide;
+    auto cellOf = [&](double c) {
+      return std::min(cellsPerSide - 1, static_cast<size_t>(c / cellSize));
+    };
+    std::vector<std::vector<size_t>> cells(cellsPerSide * cellsPerSide);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      cells[cellOf(nodes[i].y) * cellsPerSide + cellOf(nodes[i].x)].push_back(i);
+    }
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      size_t cx = cellOf(nodes[i].x);
+      size_t cy = cellOf(nodes[i].y);
+      for (size_t y = cy > 0 ? cy - 1 : 0; y <= std::min(cellsPerSide - 1, cy + 1); ++y) {
+        for (size_t x = cx > 0 ? cx - 1 : 0; x <= std::min(cellsPerSide - 1, cx + 1); ++x) {
+          for (size_t j : cells[y * cellsPerSide + x]) {
+            if (j > i && distance(i, j) <= radius) {
+              addStreet(i, j);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Grid of junctions where every street is a chain of degree-2 nodes. Some streets are left
+  // out so that the network is less regular.
+  void roadLike(size_t nodeCount, double spacing, size_t chainLength)
+  {
+    size_t junctions = std::max<size_t>(4, nodeCount / (1 + 2 * chainLength));
+    size_t side = std::max<size_t>(2, std::ceil(std::sqrt(junctions)));
+    std::uniform_real_distribution<double> jitter(-0.2 * spacing, 0.2 * spacing);
+    std::bernoulli_distribution dropStreet(0.15);
+    std::normal_distribution<double> bend(0, 0.05 * spacing);
+
+    for (size_t y = 0; y < side; ++y) {
+      for (size_t x = 0; x < side; ++x) {
+        nodes.push_back(GenNode { x * spacing + jitter(rand), y * spacing + jitter(rand) });
+      }
+    }
+
+    auto chain = [&](size_t from, size_t to) {
+      size_t last = from;
+      for (size_t i = 1; i <= chainLength; ++i) {
+        double t = static_cast<double>(i) / (chainLength + 1);
+        nodes.push_back(GenNode { nodes[from].x + t * (nodes[to].x - nodes[from].x) + bend(rand),
+            nodes[from].y + t * (nodes[to].y - nodes[from].y) + bend(rand) });
+        addStreet(last, nodes.size() - 1);
+        last = nodes.size() - 1;
+      }
+      addStreet(last, to);
+    };
+
+    for (size_t y = 0; y < side; ++y) {
+      for (size_t x = 0; x < side; ++x) {
+        size_t id = y * side + x;
+        // Keep the outer ring so the network stays connected
+        bool border = x == 0 || y == 0 || x + 1 == side || y + 1 == side;
+        if (x + 1 < side && (border || !dropStreet(rand))) {
+          chain(id, id + 1);
+        }
+        if (y + 1 < side && (border || !dropStreet(rand))) {
+          chain(id, id + side);
+        }
+      }
+    }
+  }
+
+  void writeToStream(std::ostream& out, const std::string& description) const
+  {
+    out << "# Synthetic graph: " << description << '\n';
+    out << "# correlation: " << correlation << ", spread: " << spread << '\n';
+    out << '\n';
+    out << std::setprecision(7);
+    out << dim << '\n';
+    out << nodes.size() << '\n';
+    out << edges.size() << '\n';
+
+    double lngScale = metersPerDegree * std::cos(baseLat * M_PI / 180);
+    for (size_t i = 0; i < nodes.size(); ++i) {
+      out << i << ' ' << i << ' ' << std::setprecision(9) << baseLat + nodes[i].y / metersPerDegree
+          << ' ' << baseLng + nodes[i].x / lngScale << std::setprecision(7) << " 0 0" << '\n';
+    }
+    for (const auto& e : edges) {
+      out << e.source << ' ' << e.dest;
+      for (double c : e.costs) {
+        out << ' ' << c;
+      }
+      out << " -1 -1" << '\n';
+    }
+  }
+
+  size_t nodeCount() const { return nodes.size(); }
+  size_t edgeCount() const { return edges.size(); }
+
+  private:
+  double distance(size_t a, size_t b) const
+  {
+    return std::hypot(nodes[a].x - nodes[b].x, nodes[a].y - nodes[b].y);
+  }
+
+  // Each metric is the street length scaled by a log-normal factor. The factors share a common
+  // component whose weight is |correlation|. For negative correlations the sign of the shared
+  // component alternates between metrics, so neighbouring metrics trade off against each other.
+  std::vector<double> drawCosts(double length)
+  {
+    std::normal_distribution<double> normal(0, 1);
+    double shared = normal(rand);
+    double weight = std::sqrt(std::abs(correlation));
+    double own = std::sqrt(1 - std::abs(correlation));
+
+    std::vector<double> costs;
+    costs.reserve(dim);
+    for (size_t i = 0; i < dim; ++i) {
+      double sign = correlation < 0 && i % 2 == 1 ? -1 : 1;
+      double factor = sign * weight * shared + own * normal(rand);
+      costs.push_back(std::max(0.01, length * std::exp(spread * factor)));
+    }
+    return costs;
+  }
+
+  void addStreet(size_t a, size_t b)
+  {
+    double length = std::max(1.0, distance(a, b));
+    edges.push_back(GenEdge { a, b, drawCosts(length) });
+    edges.push_back(GenEdge { b, a, drawCosts(length) });
+  }
+
+  size_t dim;
+  double correlation;
+  double spread;
+  std::mt19937_64 rand;
+  std::vector<GenNode> nodes;
+  std::vector<GenEdge> edges;
+};
+
+namespace po = boost::program_options;
+int main(int argc, char* argv[])
+{
+  std::string topology;
+  std::string saveFileName {};
+  size_t nodeCount;
+  size_t dim;
+  size_t chainLength;
+  double degree;
+  double spacing;
+  double correlation;
+  double spread;
+  unsigned long seed;
+
+  po::options_description generation { "generation options" };
+
+  // clang-format off
+  generation.add_options()
+    ("topology,t", po::value<std::string>(&topology)->default_value("grid"), "One of grid, geometric or road")
+    ("nodes,n", po::value<size_t>(&nodeCount)->default_value(10000), "Approximate number of nodes")
+    ("dim,d", po::value<size_t>(&dim)->default_value(GRAPH_DIM), "Number of metrics per edge")
+    ("correlation,c", po::value<double>(&correlation)->default_value(0.5), "Correlation of the metrics in [-1, 1]")
+    ("spread", po::value<double>(&spread)->default_value(0.5), "Standard deviation of the log-normal cost factors")
+    ("seed,s", po::value<unsigned long>(&seed)->default_value(42), "Seed of the random generator")
+    ("spacing", po::value<double>(&spacing)->default_value(100), "Distance between neighbouring nodes in meters")
+    ("degree", po::value<double>(&degree)->default_value(6), "Average degree of geometric graphs")
+    ("chain", po::value<size_t>(&chainLength)->default_value(3), "Degree-2 nodes per street of road graphs");
+  // clang-format on
+
+  po::options_description saving { "saving" };
+
+  // clang-format off
+  saving.add_options()
+    ("write,w", po::value<std::string>(&saveFileName), "File to save graph to (default stdout)")
+    ("zo", "gzip outfile");
+  // clang-format on
+
+  po::options_description all;
+  all.add_options()("help,h", "Prints help message");
+  all.add(generation).add(saving);
+
+  po::variables_map vm {};
+  po::store(po::parse_command_line(argc, argv, all), vm);
+  po::notify(vm);
+
+  if (vm.count("help") > 0) {
+    std::cout << all << '\n';
+    return 0;
+  }
+
+  GraphGenerator gen { dim, correlation, spread, seed };
+  std::stringstream description;
+  if (topology == "grid") {
+    gen.grid(nodeCount, spacing);
+    description << "grid";
+  } else if (topology == "geometric") {
+    gen.geometric(nodeCount, spacing, degree);
+    description << "random geometric with average degree " << degree;
+  } else if (topology == "road") {
+    gen.roadLike(nodeCount, spacing, chainLength);
+    description << "road-like with chains of " << chainLength << " nodes";
+  } else {
+    std::cerr << "Unknown topology " << topology << '\n';
+    std::cout << all << '\n';
+    return 1;
+  }
+  description << ", seed " << seed;
+
+  namespace iostr = boost::iostreams;
+  std::ofstream outFile;
+  iostr::filtering_ostream out {};
+  if (vm.count("zo") > 0) {
+    iostr::gzip_params params {};
+    params.level = 9;
+    out.push(iostr::gzip_compressor(params));
+  }
+  if (vm.count("write") > 0) {
+    outFile.open(saveFileName);
+    out.push(outFile);
+  } else {
+    out.push(std::cout);
+  }
+
+  gen.writeToStream(out, description.str());
+
+  std::cerr << "Generated " << gen.nodeCount() << " nodes and " << gen.edgeCount() << " edges"
+            << '\n';
+  return 0;
+}
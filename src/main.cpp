@@ -19,6 +19,11 @@
 #include "dijkstra.hpp"
 #include "graph_loading.hpp"
 #include "graphml.hpp"
+#include "lpCorpus.hpp"
+#include "mappedGraph.hpp"
+#include "metricUpdate.hpp"
+#include "partition.hpp"
+#include "witnessTrace.hpp"
 #include <boost/filesystem.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
@@ -28,11 +33,43 @@
 #include <iomanip>
 #include <random>
 
-Graph contractGraph(Graph& g, double rest, bool printStats, size_t maxThreads)
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+struct ContractionOptions {
+  bool printStats = false;
+  size_t maxThreads = 1;
+  size_t partitions = 1;
+  bool deterministic = false;
+  bool async = false;
+  bool witnessCache = false;
+  PairBudget budget {};
+  bool numa = false;
+  bool configRegions = false;
+};
+
+template <class C> void applyOptions(C& c, const ContractionOptions& options)
+{
+  c.setDeterministic(options.deterministic);
+  c.setAsync(options.async);
+  c.setWitnessCache(options.witnessCache);
+  c.setPairBudget(options.budget);
+  c.setConfigRegions(options.configRegions);
+}
+
+Graph contractGraph(Graph& g, double rest, const ContractionOptions& options)
 {
-  Contractor c { printStats, maxThreads };
   auto start = std::chrono::high_resolution_clock::now();
-  Graph ch = c.contractCompletely(g, rest);
+  Graph ch { std::vector<Node>(), std::vector<Edge>() };
+  if (options.partitions > 1) {
+    PartitionContractor c { options.partitions, options.printStats, options.maxThreads };
+    applyOptions(c, options);
+    ch = c.contractCompletely(g, rest);
+  } else {
+    Contractor c { options.printStats, options.maxThreads };
+    applyOptions(c, options);
+    c.setPinThreads(options.numa);
+    ch = c.contractCompletely(g, rest);
+  }
   auto end = std::chrono::high_resolution_clock::now();
   using m = std::chrono::minutes;
   std::cout << "contracting the graph took " << std::chrono::duration_cast<m>(end - start).count()
@@ -57,9 +94,10 @@ std::string return_current_time_and_date()
 
 using ms = std::chrono::milliseconds;
 
-int testGraph(Graph& g)
+int testGraph(Graph& g, bool configRegions)
 {
   Dijkstra d = g.createDijkstra();
+  d.pruneByConfigRegion(configRegions);
   NormalDijkstra n = g.createNormalDijkstra(true);
   std::random_device rd {};
   std::uniform_int_distribution<size_t> dist(0, g.getNodeCount() - 1);
@@ -167,12 +205,13 @@ int testGraph(Graph& g)
   std::cout << "Did not find a route in " << noRoute << " cases" << '\n';
   std::cout << "average speed up is " << static_cast<double>(nTime) / dTime << '\n';
   std::cout << "average CH Dijkstra time: " << static_cast<double>(dTime) / route << "ms " << '\n';
+  std::cout << "average relaxed CH edges: " << static_cast<double>(d.relaxedEdges) / route << '\n';
   std::cout << "average    Dijkstra time: " << static_cast<double>(nTime) / route << "ms " << '\n';
   return 0;
 }
 
 namespace po = boost::program_options;
-int main(int argc, char* argv[])
+int run(int argc, char* argv[])
 {
   try {
     std::cout.imbue(std::locale(""));
@@ -182,8 +221,20 @@ int main(int argc, char* argv[])
 
   std::string loadFileName {};
   std::string saveFileName {};
+  size_t partitions = 1;
   double contractionPercent;
+  size_t dim = Cost::dim;
   size_t maxThreads = std::thread::hardware_concurrency();
+  PairBudget budget {};
+  size_t maxPairTime = 0;
+  std::string writeQueryFileName {};
+  std::string lpCorpusFileName {};
+  double lpSampleRate = 0.01;
+  std::string witnessTraceFileName {};
+  double witnessSampleRate = 0.001;
+  std::vector<size_t> witnessRounds { 1 };
+  std::string costChangesFileName {};
+  std::string witnessFileName {};
 
   po::options_description loading { "loading options" };
 
@@ -192,7 +243,8 @@ int main(int argc, char* argv[])
     ("text,t", po::value<std::string>(&loadFileName), "Load graph from text file")
     ("multi,m", po::value<std::string>(&loadFileName), "Load graph from multiple files")
     ("graphml,g", po::value<std::string>(&loadFileName), "Load garph from graphml file")
-    ("zi", "input text file is gzipped");
+    ("zi", "input text file is gzipped")
+    ("dim", po::value<size_t>(&dim), "Dimension of the graph, needed by multi-ch for graphml files");
   // clang-format on
 
   po::options_description contraction { "contraction options" };
@@ -200,6 +252,42 @@ int main(int argc, char* argv[])
       "How far the graph should be contracted");
   contraction.add_options()("stats", "Print statistics while contracting");
   contraction.add_options()("threads", po::value(&maxThreads), "Maximal number of threads used");
+  contraction.add_options()(
+      "deterministic", "Create the same shortcuts regardless of the number of threads");
+  contraction.add_options()(
+      "async", "Contract more nodes while threads wait for the end of a round");
+  contraction.add_options()(
+      "witness-cache", "Reuse witness paths of earlier rounds as constraints");
+  contraction.add_options()("max-lp-calls", po::value(&budget.lpCalls),
+      "Create the shortcut of an edge pair after this many LP calls");
+  contraction.add_options()("max-constraints", po::value(&budget.constraints),
+      "Create the shortcut of an edge pair after this many constraints");
+  contraction.add_options()("max-pair-time", po::value(&maxPairTime),
+      "Create the shortcut of an edge pair after this many milliseconds");
+  contraction.add_options()(
+      "numa", "Pin threads to cores and spread the graph over all NUMA nodes");
+  contraction.add_options()(
+      "huge-pages", "Back the graph and search arrays with transparent huge pages");
+  contraction.add_options()("config-regions",
+      "Store for which configs shortcuts are needed and skip them in the other queries");
+  contraction.add_options()("record-lps", po::value(&lpCorpusFileName),
+      "Record a sample of the solved LPs to this file for bench_lp");
+  contraction.add_options()("lp-sample", po::value(&lpSampleRate)->default_value(0.01),
+      "Fraction of the LPs recorded with --record-lps");
+  contraction.add_options()("record-witness", po::value(&witnessTraceFileName),
+      "Record a sample of the witness searches to this file for bench_witness");
+  contraction.add_options()("witness-sample", po::value(&witnessSampleRate)->default_value(0.001),
+      "Fraction of the witness searches recorded with --record-witness");
+  contraction.add_options()("witness-rounds",
+      po::value(&witnessRounds)->default_value(witnessRounds, "1")->multitoken(),
+      "Contraction rounds whose witness searches and graph are recorded with --record-witness");
+  contraction.add_options()("update-costs", po::value(&costChangesFileName),
+      "Apply the edge costs in this file to the loaded contracted graph instead of contracting");
+  contraction.add_options()("update-witnesses", po::value(&witnessFileName),
+      "Read the witnesses of --update-costs from this file if it exists and write them after the "
+      "update");
+  contraction.add_options()("partitions", po::value(&partitions),
+      "Contract the interior of this many cells in separate processes first");
 
   po::options_description saving { "saving" };
 
@@ -208,6 +296,7 @@ int main(int argc, char* argv[])
     ("write,w", po::value<std::string>(&saveFileName), "File to save graph to")
     ("zo", "gzip outfile")
     ("write-graphml,wg", po::value<std::string>(&saveFileName), "Graphml file to save graph to.")
+    ("write-query-file", po::value<std::string>(&writeQueryFileName), "Query file to save graph to")
     ("using-osm-ids", "Using osm-ids instead of node-indices when writing edges")
     ("external-edge-ids", "Read and write an extrenal edge index before each edge");
   // clang-format on
@@ -217,15 +306,30 @@ int main(int argc, char* argv[])
   all.add(loading).add(contraction).add(saving);
 
   po::variables_map vm {};
-  po::store(po::parse_command_line(argc, argv, all), vm);
-  po::notify(vm);
+  try {
+    po::store(po::parse_command_line(argc, argv, all), vm);
+    po::notify(vm);
+  } catch (po::error& e) {
+    std::cerr << e.what() << '\n';
+    return 1;
+  }
 
   if (vm.count("help") > 0) {
     std::cout << all << '\n';
     return 0;
   }
 
+  if (dim != Cost::dim) {
+    std::cerr << "Graph of dimension " << dim << " requested but code is compiled for dimension "
+              << Cost::dim << '\n';
+    return 1;
+  }
+
   Edge::use_external_edge_ids(vm.count("external-edge-ids") > 0);
+  HugePages::enable(vm.count("huge-pages") > 0);
+  LpCorpus::record(lpCorpusFileName, lpSampleRate);
+  WitnessTrace::record(witnessTraceFileName, witnessSampleRate,
+      std::set<size_t>(witnessRounds.begin(), witnessRounds.end()));
 
   Graph g { std::vector<Node>(), std::vector<Edge>() };
   if (vm.count("text") > 0) {
@@ -241,9 +345,40 @@ int main(int argc, char* argv[])
     return 0;
   }
 
-  bool printStats = vm.count("stats") > 0;
-  std::cout << "Start contracting" << '\n';
-  g = contractGraph(g, 100 - contractionPercent, printStats, maxThreads);
+  ContractionOptions options {};
+  options.printStats = vm.count("stats") > 0;
+  options.maxThreads = maxThreads;
+  options.partitions = partitions;
+  options.deterministic = vm.count("deterministic") > 0;
+  options.async = vm.count("async") > 0;
+  options.witnessCache = vm.count("witness-cache") > 0;
+  options.budget = budget;
+  options.budget.time = std::chrono::milliseconds { maxPairTime };
+  options.numa = vm.count("numa") > 0;
+  options.configRegions = vm.count("config-regions") > 0;
+  if (vm.count("update-costs") > 0) {
+    auto changes = MetricUpdate::readChanges(costChangesFileName);
+    auto start = std::chrono::high_resolution_clock::now();
+    MetricUpdate update { g, maxThreads };
+    bool witnesses = vm.count("update-witnesses") > 0;
+    if (witnesses && boost::filesystem::exists(witnessFileName)) {
+      update.readWitnesses(witnessFileName);
+    }
+    update.update(changes);
+    if (witnesses) {
+      update.writeWitnesses(witnessFileName);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::cout << "Updated " << changes.size() << " edges and " << update.updatedShortcuts()
+              << " shortcuts, checked " << update.checkedPairs() << " pairs at "
+              << update.checkedNodes() << " nodes and added " << update.addedShortcuts()
+              << " shortcuts in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count()
+              << "ms" << '\n';
+  } else {
+    std::cout << "Start contracting" << '\n';
+    g = contractGraph(g, 100 - contractionPercent, options);
+  }
 
   if (vm.count("write") > 0) {
     namespace iostr = boost::iostreams;
@@ -277,6 +412,17 @@ int main(int argc, char* argv[])
 
     write_graphml(out, g);
   }
+  if (vm.count("write-query-file") > 0) {
+    std::cout << "saving query file" << '\n';
+    MappedGraph::write(g, writeQueryFileName);
+  }
 
-  return testGraph(g);
+  return testGraph(g, options.configRegions);
 }
+
+} // namespace MULTI_CH_DIM_NAMESPACE
+
+// multi-ch links this file once per dimension and provides its own main in dispatch.cpp
+#ifndef MULTI_CH_DISPATCH
+int main(int argc, char* argv[]) { return run(argc, argv); }
+#endif
@@ -19,6 +19,8 @@
 #define CONTRACTIONLP_H
 
 #include "graph.hpp"
+#include "lpCorpus.hpp"
+#include "placement.hpp"
 #include <boost/dll.hpp>
 #include <boost/process/child.hpp>
 #include <boost/process/io.hpp>
@@ -26,6 +28,8 @@
 #include <sstream>
 #include <string>
 
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
 const auto dir = boost::dll::program_location().parent_path();
 
 namespace bp = boost::process;
@@ -62,6 +66,9 @@ class ContractionLp {
       lpInput << ss.str() << ' ';
     }
     lpInput << '\n';
+    if (LpCorpus::recording()) {
+      constraints_.push_back(coeff);
+    }
   }
   bool solve()
   {
@@ -72,6 +79,7 @@ class ContractionLp {
     lpInput.flush();
     lpOutput >> lpResult;
     if (lpResult == "Infeasible") {
+      record(false);
       return false;
     }
 
@@ -83,12 +91,15 @@ class ContractionLp {
     }
     lpOutput >> delta_;
 
+    record(true);
     return true;
   }
   std::vector<double> variableValues() const { return variableValues_; }
 
   double delta() const { return delta_; }
 
+  void pin(int cpu) { Placement::pinProcess(lp.id(), cpu); }
+
   static const std::string lp_executable()
   {
     std::stringstream name;
@@ -98,10 +109,22 @@ class ContractionLp {
 
   protected:
   private:
+  void record(bool feasible)
+  {
+    if (!constraints_.empty() && LpCorpus::sample()) {
+      LpCorpus::add(LpProblem { std::move(constraints_), feasible, variableValues_, delta_ });
+    }
+    constraints_.clear();
+  }
+
+  // Constraints of the current problem, only kept while recording
+  std::vector<std::array<double, Cost::dim>> constraints_;
   bp::ipstream lpOutput;
   bp::opstream lpInput;
   bp::child lp;
   std::string lpResult;
 };
 
+} // namespace MULTI_CH_DIM_NAMESPACE
+
 #endif /* CONTRACTIONLP_H */
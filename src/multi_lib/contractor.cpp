@@ -19,14 +19,26 @@
 #include "contractor.hpp"
 #include "contractionLP.hpp"
 #include "multiqueue.hpp"
+#include "placement.hpp"
+#include "witnessCache.hpp"
+#include "witnessTrace.hpp"
 #include <any>
 #include <chrono>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <numeric>
+#include <tuple>
+#include <sys/resource.h>
+#include <unistd.h>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
 
 class StatisticsCollector {
   public:
-  enum class CountType { shortestPath, repeatingConfig, unknownReason };
+  enum class CountType { shortestPath, repeatingConfig, unknownReason, budgetExceeded };
 
   StatisticsCollector(bool active)
       : active(active) {};
@@ -38,8 +50,11 @@ class StatisticsCollector {
       return;
     }
     std::lock_guard guard(key);
-    std::cout << shortCount << "\t\t" << sameCount << "\t\t\t" << unknown << "\t\t\t" << lpMax
-              << "\t\t" << constMax << '\n';
+    std::cout << shortCount << "\t\t" << sameCount << "\t\t\t" << unknown << "\t\t" << budget
+              << "\t\t" << lpMax
+              << "\t\t" << constMax << "\t\t\t" << cacheHits << "\t" << warmPairs * 100 / pairs
+              << "\t" << std::chrono::duration_cast<ms>(maxPairTime).count() << "\t\t"
+              << std::chrono::duration_cast<ms>(busyTime).count() << '\n';
   }
   StatisticsCollector& operator=(const StatisticsCollector& other) = default;
   StatisticsCollector& operator=(StatisticsCollector&& other) noexcept = default;
@@ -47,7 +62,8 @@ class StatisticsCollector {
   static void printHeader()
   {
     std::cout << "| \t\t Reasons for shortcut creation \t\t | \t\t  Max values \t\t|  " << '\n';
-    std::cout << "short \t\t repeating \t\t unknown \t\t lp calls \t max constraints" << '\n';
+    std::cout << "short \t\t repeating \t\t unknown \t budget \t lp calls \t max constraints"
+              << " \t cached \t warm % \t max pair ms \t busy ms" << '\n';
   }
 
   void countShortcut(CountType t)
@@ -65,6 +81,10 @@ class StatisticsCollector {
       ++unknown;
       break;
     }
+    case CountType::budgetExceeded: {
+      ++budget;
+      break;
+    }
     }
   }
   void recordMaxValues(size_t lpCalls, size_t constraints)
@@ -72,6 +92,19 @@ class StatisticsCollector {
     lpMax = std::max(lpCalls, lpMax);
     constMax = std::max(constraints, constMax);
   }
+  void countCacheHit() { ++cacheHits; }
+  void recordPairTime(std::chrono::nanoseconds time)
+  {
+    maxPairTime = std::max(time, maxPairTime);
+    busyTime += time;
+  }
+  void countPair(bool warm)
+  {
+    ++pairs;
+    if (warm) {
+      ++warmPairs;
+    }
+  }
 
   protected:
   private:
@@ -79,16 +112,63 @@ class StatisticsCollector {
   size_t shortCount = 0;
   size_t sameCount = 0;
   size_t unknown = 0;
+  size_t budget = 0;
   size_t lpMax = 0;
   size_t constMax = 0;
+  size_t cacheHits = 0;
+  size_t pairs = 0;
+  size_t warmPairs = 0;
+  std::chrono::nanoseconds maxPairTime { 0 };
+  std::chrono::nanoseconds busyTime { 0 };
+  using ms = std::chrono::milliseconds;
   static std::mutex key;
 };
 std::mutex StatisticsCollector::key {};
 
+size_t currentRss()
+{
+  std::ifstream statm { "/proc/self/statm" };
+  size_t pages = 0;
+  size_t residentPages = 0;
+  statm >> pages >> residentPages;
+  return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+size_t peakRss()
+{
+  rusage usage {};
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+void printMemory(const std::string& name, size_t bytes)
+{
+  std::cout << "..." << std::setw(28) << std::left << name << std::right << std::setw(10)
+            << bytes / (1024 * 1024) << " MiB" << '\n';
+}
+
+// Nodes of the independent set which are contracted by threads waiting for the end of a round
+struct ExtraNodes {
+  MultiQueue<EdgePair> queue {};
+  std::atomic<size_t> pending { 0 };
+  std::mutex key {};
+  std::vector<NodePos> contractedNodes {};
+};
+
+// Config regions of the shortcuts of a round by the edges they replace, until the shortcuts have
+// ids
+struct ShortcutRegions {
+  std::mutex key {};
+  std::map<std::pair<EdgeId, EdgeId>, ConfigRegion> regions {};
+};
+
 std::pair<bool, std::optional<RouteWithCount>> checkShortestPath(
     NormalDijkstra& d, const HalfEdge& startEdge, const HalfEdge& destEdge, const Config& conf)
 {
   auto foundRoute = d.findBestRoute(startEdge.end, destEdge.end, conf);
+  if (WitnessTrace::recording() && WitnessTrace::sample()) {
+    WitnessTrace::add(startEdge, destEdge, conf, foundRoute ? &foundRoute->costs : nullptr);
+  }
   if (!foundRoute) {
     return std::make_pair(false, foundRoute);
   }
@@ -99,6 +179,14 @@ std::pair<bool, std::optional<RouteWithCount>> checkShortestPath(
   return std::make_pair(isShortest, foundRoute);
 }
 
+// Average number of edge pairs grouped at once in Contractor::contract
+const size_t pairChunkSize = 100000;
+
+bool sameEnds(const EdgePair& a, const EdgePair& b)
+{
+  return a.in.end == b.in.end && a.out.end == b.out.end;
+}
+
 class ContractingThread {
   MultiQueue<EdgePair>* queue;
   Graph* graph;
@@ -115,17 +203,32 @@ class ContractingThread {
   std::vector<Cost> constraints;
   RouteWithCount route;
   const std::set<NodePos>& set;
+  std::atomic<size_t>* workerMemory;
+  ExtraNodes* extra;
+  WitnessCache* cache;
+  std::vector<Cost> cached;
+  PairBudget pairBudget;
+  int cpu;
+  ShortcutRegions* regions;
 
   public:
   ContractingThread(MultiQueue<EdgePair>* queue, Graph* g, const std::set<NodePos>& set,
-      ContractionLp* lp, bool printStatistics)
+      ContractionLp* lp, bool printStatistics, std::atomic<size_t>* workerMemory,
+      ExtraNodes* extra, WitnessCache* cache, PairBudget pairBudget, int cpu, ShortcutRegions* regions)
       : queue(queue)
       , graph(g)
       , stats(printStatistics)
       , config(std::vector(Cost::dim, 1.0 / Cost::dim))
       , lp(lp)
-      , d(g->createNormalDijkstra())
+      // Allocated by the worker thread, after pinning it
+      , d(g, 0)
       , set(set)
+      , workerMemory(workerMemory)
+      , extra(extra)
+      , cache(cache)
+      , pairBudget(pairBudget)
+      , cpu(cpu)
+      , regions(regions)
   {
     shortcuts.reserve(graph->getNodeCount());
   }
@@ -138,6 +241,12 @@ class ContractingThread {
       , lp(c.lp)
       , d(c.d)
       , set(c.set)
+      , workerMemory(c.workerMemory)
+      , extra(c.extra)
+      , cache(c.cache)
+      , pairBudget(c.pairBudget)
+      , cpu(c.cpu)
+      , regions(c.regions)
   {
   }
 
@@ -149,6 +258,12 @@ class ContractingThread {
       , lp(std::move(c.lp))
       , d(std::move(c.d))
       , set(std::move(c.set))
+      , workerMemory(c.workerMemory)
+      , extra(c.extra)
+      , cache(c.cache)
+      , pairBudget(c.pairBudget)
+      , cpu(c.cpu)
+      , regions(c.regions)
   {
   }
 
@@ -191,8 +306,39 @@ class ContractingThread {
     stats.countShortcut(type);
     stats.recordMaxValues(lpCount, constraints.size());
     shortcuts.push_back(Contractor::createShortcut(Edge::getEdge(in.id), Edge::getEdge(out.id)));
+    if (regions) {
+      if (auto region = configRegion()) {
+        std::lock_guard guard(regions->key);
+        regions->regions[std::make_pair(in.id, out.id)] = *region;
+      }
+    }
   };
 
+  // Keeps the witnesses which are cheaper than the shortcut for the most configs around the
+  // center of the config space
+  std::optional<ConfigRegion> configRegion()
+  {
+    std::vector<Cost> halfSpaces;
+    for (const auto& c : constraints) {
+      Cost difference = c - shortcutCost;
+      if (std::any_of(difference.values.begin(), difference.values.end(),
+              [](double v) { return v < -COST_ACCURACY; })) {
+        halfSpaces.push_back(difference);
+      }
+    }
+    if (halfSpaces.empty()) {
+      return {};
+    }
+    auto sum = [](const Cost& c) { return std::accumulate(c.values.begin(), c.values.end(), 0.0); };
+    std::sort(halfSpaces.begin(), halfSpaces.end(),
+        [&sum](const Cost& a, const Cost& b) { return sum(a) < sum(b); });
+
+    ConfigRegion region;
+    region.count = std::min(halfSpaces.size(), ConfigRegion::maxHalfSpaces);
+    std::copy(halfSpaces.begin(), halfSpaces.begin() + region.count, region.halfSpaces.begin());
+    return region;
+  }
+
   bool testConfig(const Config& c)
   {
     auto [isShortest, foundRoute] = checkShortestPath(d, in, out, c);
@@ -218,6 +364,10 @@ class ContractingThread {
       return true;
     }
 
+    if (cache) {
+      cache->insert(graph->getNode(in.end).id(), graph->getNode(out.end).id(), currentCost);
+    }
+
     if (isDominated(currentCost)) {
       return true;
     }
@@ -241,91 +391,184 @@ class ContractingThread {
     constraints.erase(last, constraints.end());
   }
 
-  std::vector<Edge> operator()()
+  bool budgetExceeded(std::chrono::steady_clock::time_point start)
   {
-    std::vector<EdgePair> messages;
-    while (true) {
-      messages.clear();
-      if (queue->receive_some(messages, 20) == 0 && queue->closed()) {
-        return std::move(shortcuts);
-      }
-      for (auto& pair : messages) {
-        bool warm = false;
-        if (pair.in.end == in.end && pair.out.end == out.end) {
-          warm = true;
-        } else {
-          constraints.clear();
-        }
+    return (pairBudget.lpCalls > 0 && lpCount >= pairBudget.lpCalls)
+        || (pairBudget.constraints > 0 && constraints.size() >= pairBudget.constraints)
+        || (pairBudget.time.count() > 0
+            && std::chrono::steady_clock::now() - start >= pairBudget.time);
+  }
 
-        in = pair.in;
-        out = pair.out;
+  void contractPair(const EdgePair& pair)
+  {
+    auto start = std::chrono::steady_clock::now();
+    bool warm = false;
+    // Pairs with the same end nodes are received as one group, so the constraints of a group
+    // only depend on the pairs of this group
+    if (pair.in.end == in.end && pair.out.end == out.end) {
+      warm = true;
+    } else {
+      constraints.clear();
+    }
+    stats.countPair(warm);
 
-        if (in.begin != out.begin) {
-          throw std::invalid_argument("In out pair does not belong together");
-        }
-        auto in_edge = Edge::getMutEdge(in.id);
-        auto out_edge = Edge::getMutEdge(out.id);
+    in = pair.in;
+    out = pair.out;
 
-        if (in_edge.getDestId() != out_edge.getSourceId()) {
-          throw std::invalid_argument("In out edges do not belong together");
-        }
+    if (in.begin != out.begin) {
+      throw std::invalid_argument("In out pair does not belong together");
+    }
+    auto in_edge = Edge::getMutEdge(in.id);
+    auto out_edge = Edge::getMutEdge(out.id);
 
-        std::vector<double> coeff(Cost::dim, 1.0 / Cost::dim);
-        config = Config { coeff };
-        shortcutCost = in.cost + out.cost;
+    if (in_edge.getDestId() != out_edge.getSourceId()) {
+      throw std::invalid_argument("In out edges do not belong together");
+    }
 
-        if (!warm) {
-          warm = true;
-          bool finished = false;
-          for (size_t i = 0; i < Cost::dim; ++i) {
-            std::vector<double> values(Cost::dim, 0);
-            values[i] = 1;
-            if (testConfig(values)) {
-              finished = true;
-              break;
+    std::vector<double> coeff(Cost::dim, 1.0 / Cost::dim);
+    config = Config { coeff };
+    shortcutCost = in.cost + out.cost;
+
+    // Witnesses of earlier pairs are valid constraints, so the LP can be solved before the first
+    // dijkstra run. A witness cheaper in every dimension makes the shortcut unnecessary.
+    bool solveFirst = false;
+    if (cache && !warm) {
+      cached.clear();
+      cache->find(graph->getNode(in.end).id(), graph->getNode(out.end).id(), cached);
+      if (std::any_of(cached.begin(), cached.end(), [this](const Cost& c) {
+            for (size_t i = 0; i < Cost::dim; ++i) {
+              if (c.values[i] >= shortcutCost.values[i] - COST_ACCURACY) {
+                return false;
+              }
             }
-          }
-          if (finished) {
-            continue;
-          }
-        }
+            return true;
+          })) {
+        stats.countCacheHit();
+        return;
+      }
+      if (!cached.empty()) {
+        constraints = cached;
+        solveFirst = true;
+        warm = true;
+      }
+    }
 
-        for (auto c : constraints) {
-          if (isDominated(c))
-            continue;
+    if (!warm) {
+      warm = true;
+      bool finished = false;
+      for (size_t i = 0; i < Cost::dim; ++i) {
+        std::vector<double> values(Cost::dim, 0);
+        values[i] = 1;
+        if (testConfig(values)) {
+          finished = true;
+          break;
         }
+      }
+      if (finished) {
+        return;
+      }
+    }
 
-        lpCount = 0;
-        while (true) {
+    for (auto c : constraints) {
+      if (isDominated(c))
+        continue;
+    }
 
-          if (testConfig(config)) {
-            break;
-          }
-          dedupConstraints();
+    lpCount = 0;
+    bool test = !solveFirst;
+    while (true) {
 
-          for (auto& c : constraints) {
-            addConstraint(c);
-          }
+      if (test && testConfig(config)) {
+        break;
+      }
+      dedupConstraints();
 
-          ++lpCount;
-          if (!lp->solve()) {
-            stats.recordMaxValues(lpCount, constraints.size());
-            break;
-          }
-          auto values = lp->variableValues();
-
-          Config newConfig { values };
-          if (newConfig == config) {
-            if (currentCost * config >= shortcutCost * config - COST_ACCURACY) {
-              storeShortcut(StatisticsCollector::CountType::repeatingConfig);
-            } else {
-              storeShortcut(StatisticsCollector::CountType::unknownReason);
-            }
-            break;
-          }
+      // Keeping an unnecessary shortcut does not change any shortest path
+      if (budgetExceeded(start)) {
+        storeShortcut(StatisticsCollector::CountType::budgetExceeded);
+        break;
+      }
+
+      for (auto& c : constraints) {
+        addConstraint(c);
+      }
+
+      ++lpCount;
+      if (!lp->solve()) {
+        stats.recordMaxValues(lpCount, constraints.size());
+        break;
+      }
+      auto values = lp->variableValues();
+
+      Config newConfig { values };
+      if (test && newConfig == config) {
+        if (currentCost * config >= shortcutCost * config - COST_ACCURACY) {
+          storeShortcut(StatisticsCollector::CountType::repeatingConfig);
+        } else {
+          storeShortcut(StatisticsCollector::CountType::unknownReason);
+        }
+        break;
+      }
+
+      test = true;
+      config = newConfig;
+    }
+  }
+
+  void contractTimed(const EdgePair& pair)
+  {
+    auto start = std::chrono::steady_clock::now();
+    contractPair(pair);
+    stats.recordPairTime(std::chrono::steady_clock::now() - start);
+  }
 
-          config = newConfig;
+  // Contracts nodes of the independent set which are not part of this round while other threads
+  // are still busy with the round. Only completely contracted nodes are reported.
+  void contractExtraNodes()
+  {
+    std::vector<EdgePair> messages;
+    auto sameNode = [](const EdgePair& a, const EdgePair& b) { return a.in.begin == b.in.begin; };
+    while (extra->pending > 0) {
+      messages.clear();
+      if (extra->queue.receive_some(messages, 20, sameNode) == 0 && extra->queue.closed()) {
+        return;
+      }
+      auto pair = messages.begin();
+      while (pair != messages.end() && extra->pending > 0) {
+        NodePos node = pair->in.begin;
+        for (; pair != messages.end() && pair->in.begin == node; ++pair) {
+          contractTimed(*pair);
         }
+        std::lock_guard guard(extra->key);
+        extra->contractedNodes.push_back(node);
+      }
+    }
+  }
+
+  std::vector<Edge> operator()()
+  {
+    if (cpu >= 0) {
+      Placement::pinThread(cpu);
+    }
+    // Its pages are first touched on the node of this thread
+    d = graph->createNormalDijkstra();
+    std::vector<EdgePair> messages;
+    while (true) {
+      messages.clear();
+      size_t received = queue->receive_some(messages, 20, sameEnds);
+      if (received == 0 && queue->closed()) {
+        if (extra) {
+          contractExtraNodes();
+        }
+        *workerMemory += d.memoryUsage() + shortcuts.capacity() * sizeof(Edge)
+            + constraints.capacity() * sizeof(Cost);
+        return std::move(shortcuts);
+      }
+      for (auto& pair : messages) {
+        contractTimed(pair);
+      }
+      if (extra) {
+        extra->pending -= messages.size();
       }
     }
   }
@@ -367,7 +610,19 @@ Edge Contractor::createShortcut(const Edge& e1, const Edge& e2)
 std::future<std::vector<Edge>> Contractor::contract(
     MultiQueue<EdgePair>& queue, Graph& g, ContractionLp* lp, const std::set<NodePos>& set)
 {
-  return std::async(std::launch::async, ContractingThread { &queue, &g, set, lp, printStatistics });
+  PairBudget budget = pairBudget;
+  // How far a pair gets in a given time depends on the machine and its load
+  if (deterministic) {
+    budget.time = std::chrono::milliseconds { 0 };
+  }
+  int cpu = -1;
+  auto worker = std::find_if(lps.begin(), lps.end(), [lp](const auto& l) { return l.get() == lp; });
+  if (pinThreads && worker != lps.end()) {
+    cpu = Placement::cpuOfWorker(worker - lps.begin());
+  }
+  return std::async(std::launch::async,
+      ContractingThread { &queue, &g, set, lp, printStatistics, &workerMemory, extraNodes.get(),
+          deterministic ? nullptr : witnessCache.get(), budget, cpu, shortcutRegions.get() });
 }
 
 std::set<NodePos> Contractor::independentSet(const Graph& g)
@@ -387,6 +642,11 @@ std::set<NodePos> Contractor::independentSet(const Graph& g)
   std::sort(nodes.begin(), nodes.end());
 
   std::vector<bool> selected(nodeCount, true);
+  if (!frozenNodes.empty()) {
+    for (size_t i = 0; i < nodeCount; ++i) {
+      selected[i] = frozenNodes.count(g.getNode(NodePos { i }).id()) == 0;
+    }
+  }
 
   for (size_t i = 0; i < nodeCount; ++i) {
     NodePos pos = nodes[i].second;
@@ -448,62 +708,140 @@ Graph Contractor::contract(Graph& g)
   MultiQueue<EdgePair> q {};
 
   ++level;
-  auto set = reduce(independentSet(g), g);
+  workerMemory = 0;
+  if (WitnessTrace::recording()) {
+    WitnessTrace::beginRound(g);
+  }
+  if (pinThreads) {
+    g.interleaveMemory();
+    Edge::interleaveMemory();
+  }
+  auto independent = independentSet(g);
+  auto set = reduce(independent, g);
+  // All nodes of the independent set may be contracted in async mode
+  bool useExtraNodes = async && !deterministic;
+  if (useExtraNodes) {
+    extraNodes = std::make_unique<ExtraNodes>();
+  }
   std::vector<std::future<std::vector<Edge>>> futures;
   for (size_t i = 0; i < THREAD_COUNT; ++i) {
-    futures.push_back(contract(q, g, lps[i].get(), set));
+    futures.push_back(contract(q, g, lps[i].get(), useExtraNodes ? independent : set));
   }
   std::vector<Node> nodes {};
   std::vector<EdgeId> edges {};
-  std::vector<NodePos> nodesToContract {};
-  nodesToContract.reserve(set.size());
-
-  for (size_t i = 0; i < g.getNodeCount(); ++i) {
-    NodePos pos { i };
-    if (set.find(pos) == set.end()) {
-      nodes.push_back(g.getNode(pos));
-      for (const auto& edge : g.getOutgoingEdgesOf(pos)) {
-        if (set.find(edge.end) == set.end()) {
-          edges.push_back(edge.id);
+  std::vector<NodePos> nodesToContract { set.begin(), set.end() };
+  std::unordered_set<NodeId> contractedIds {};
+
+  auto splitNodes = [&](const std::set<NodePos>& contracted) {
+    for (size_t i = 0; i < g.getNodeCount(); ++i) {
+      NodePos pos { i };
+      if (contracted.find(pos) == contracted.end()) {
+        nodes.push_back(g.getNode(pos));
+        for (const auto& edge : g.getOutgoingEdgesOf(pos)) {
+          if (contracted.find(edge.end) == contracted.end()) {
+            edges.push_back(edge.id);
+          }
+        }
+      } else {
+        Node node = g.getNode(pos);
+        node.assignLevel(level);
+        if (witnessCache) {
+          contractedIds.insert(node.id());
         }
-      }
-    } else {
-      nodesToContract.push_back(pos);
-
-      Node node = g.getNode(pos);
-      node.assignLevel(level);
 
-      contractedNodes.push_back(node);
-      copyEdgesOfNode(g, pos, contractedEdges);
+        contractedNodes.push_back(node);
+        copyEdgesOfNode(g, pos, contractedEdges);
+      }
     }
+  };
+  // Which extra nodes are contracted is only known at the end of the round
+  if (!useExtraNodes) {
+    splitNodes(set);
   }
 
   size_t edgePairCount = 0;
   size_t batchSize = THREAD_COUNT * 30;
   std::vector<EdgePair> pairs;
-  pairs.reserve(batchSize);
+  std::vector<EdgePair> batch;
+  batch.reserve(batchSize);
 
+  // Expensive groups are sent first so they do not start at the end of the round. Witness
+  // searches between end nodes with many edges settle more nodes and find more alternatives.
+  auto degree = [&g](NodePos p) {
+    auto inEdges = g.getIngoingEdgesOf(p);
+    auto outEdges = g.getOutgoingEdgesOf(p);
+    return static_cast<size_t>(
+        (inEdges.end() - inEdges.begin()) + (outEdges.end() - outEdges.begin()));
+  };
+
+  // Pairs with the same end nodes reuse each others constraints. They are sent as one group
+  // which is received by a single thread in this order. A group only contains pairs with the
+  // same in.end, so the pairs are split into chunks by in.end. Only one chunk is held at a time
+  // and the threads start working on the first chunk while the next one is built.
+  size_t pairEstimate = 0;
   for (const auto& node : nodesToContract) {
-    const auto& inEdges = g.getIngoingEdgesOf(node);
-    const auto& outEdges = g.getOutgoingEdgesOf(node);
-    for (const auto& in : inEdges) {
-      for (const auto& out : outEdges) {
-        if (in.end == out.end) {
+    auto inEdges = g.getIngoingEdgesOf(node);
+    auto outEdges = g.getOutgoingEdgesOf(node);
+    pairEstimate += (inEdges.end() - inEdges.begin()) * (outEdges.end() - outEdges.begin());
+  }
+  const size_t chunks = 1 + pairEstimate / pairChunkSize;
+
+  for (size_t chunk = 0; chunk < chunks; ++chunk) {
+    pairs.clear();
+    for (const auto& node : nodesToContract) {
+      const auto& inEdges = g.getIngoingEdgesOf(node);
+      const auto& outEdges = g.getOutgoingEdgesOf(node);
+      for (const auto& in : inEdges) {
+        if (std::hash<NodePos>()(in.end) % chunks != chunk) {
           continue;
         }
-        if (in.begin != out.begin) {
-          throw std::invalid_argument("pair is not connecting");
-        }
-        pairs.push_back(EdgePair { in, out });
-        ++edgePairCount;
-        if (pairs.size() >= batchSize) {
-          q.send(pairs);
+        for (const auto& out : outEdges) {
+          if (in.end == out.end) {
+            continue;
+          }
+          if (in.begin != out.begin) {
+            throw std::invalid_argument("pair is not connecting");
+          }
+          pairs.push_back(EdgePair { in, out });
+          ++edgePairCount;
+          if (useExtraNodes) {
+            ++extraNodes->pending;
+          }
         }
       }
     }
+    std::sort(pairs.begin(), pairs.end(), [](const EdgePair& a, const EdgePair& b) {
+      return std::tie(a.in.end, a.out.end, a.in.begin, a.in.id, a.out.id)
+          < std::tie(b.in.end, b.out.end, b.in.begin, b.in.id, b.out.id);
+    });
+
+    std::vector<std::tuple<size_t, size_t, size_t>> groups {};
+    for (size_t begin = 0, end = 0; begin < pairs.size(); begin = end) {
+      end = begin + 1;
+      while (end < pairs.size() && sameEnds(pairs[begin], pairs[end])) {
+        ++end;
+      }
+      size_t estimate
+          = (end - begin) * (degree(pairs[begin].in.end) + degree(pairs[begin].out.end));
+      groups.emplace_back(estimate, begin, end);
+    }
+    std::stable_sort(groups.begin(), groups.end(),
+        [](const auto& a, const auto& b) { return std::get<0>(a) > std::get<0>(b); });
+
+    for (const auto& [estimate, begin, end] : groups) {
+      std::copy(pairs.begin() + begin, pairs.begin() + end, std::back_inserter(batch));
+      if (batch.size() >= batchSize) {
+        q.send(batch);
+      }
+    }
   }
-  q.send(pairs);
+  q.send(batch);
   q.close();
+  pairs = std::vector<EdgePair>();
+
+  if (useExtraNodes) {
+    sendExtraPairs(g, independent, set, std::min<size_t>(edgePairCount, 1000000));
+  }
 
   if (printStatistics) {
     std::cout << "..." << edgePairCount << " edge pairs to contract" << '\n';
@@ -516,6 +854,19 @@ Graph Contractor::contract(Graph& g)
     std::move(shortcutsMsg.begin(), shortcutsMsg.end(), std::back_inserter(shortcuts));
   }
 
+  if (useExtraNodes) {
+    std::cout << "..."
+              << "contracted " << extraNodes->contractedNodes.size()
+              << " additional nodes while the round was finishing" << '\n';
+    auto contracted = set;
+    contracted.insert(extraNodes->contractedNodes.begin(), extraNodes->contractedNodes.end());
+    splitNodes(contracted);
+    extraNodes.reset();
+  }
+  if (witnessCache) {
+    witnessCache->invalidate(contractedIds);
+  }
+
   std::sort(shortcuts.begin(), shortcuts.end(), [](const auto& left, const auto& right) {
     if (left.getSourceId() < right.getSourceId())
       return true;
@@ -533,7 +884,9 @@ Graph Contractor::contract(Graph& g)
       if (left.getCost().values[i] > right.getCost().values[i])
         return false;
     }
-    return false;
+    // Total order so the kept duplicate does not depend on the order the threads finished in
+    return std::make_pair(left.getEdgeA(), left.getEdgeB())
+        < std::make_pair(right.getEdgeA(), right.getEdgeB());
   });
   auto last
       = std::unique(shortcuts.begin(), shortcuts.end(), [](const auto& left, const auto& right) {
@@ -557,8 +910,22 @@ Graph Contractor::contract(Graph& g)
   std::cout << "..."
             << "Created " << shortcuts.size() << " shortcuts." << '\n';
   auto ids = Edge::administerEdges(std::move(shortcuts));
+  if (shortcutRegions) {
+    for (auto id : ids) {
+      const auto& e = Edge::getEdge(id);
+      auto region = shortcutRegions->regions.find(std::make_pair(*e.getEdgeA(), *e.getEdgeB()));
+      if (region != shortcutRegions->regions.end()) {
+        Edge::setConfigRegion(id, region->second);
+      }
+    }
+    shortcutRegions->regions.clear();
+  }
   std::move(ids.begin(), ids.end(), std::back_inserter(edges));
 
+  if (printStatistics) {
+    printMemoryReport(g, q);
+  }
+
   auto end = std::chrono::high_resolution_clock::now();
 
   using s = std::chrono::seconds;
@@ -623,4 +990,101 @@ Graph Contractor::contractCompletely(Graph& g, double rest)
   return mergeWithContracted(intermedG);
 }
 
+void Contractor::sendExtraPairs(const Graph& g, const std::set<NodePos>& independent,
+    const std::set<NodePos>& set, size_t maxPairs)
+{
+  std::vector<std::pair<size_t, NodePos>> candidates {};
+  for (const auto& pos : independent) {
+    if (set.count(pos) == 0) {
+      auto inEdges = g.getIngoingEdgesOf(pos);
+      auto outEdges = g.getOutgoingEdgesOf(pos);
+      size_t count = (inEdges.end() - inEdges.begin()) * (outEdges.end() - outEdges.begin());
+      candidates.emplace_back(count, pos);
+    }
+  }
+  // Cheap nodes first, they are the most likely to be finished in time
+  std::sort(candidates.begin(), candidates.end());
+
+  size_t pairCount = 0;
+  std::vector<EdgePair> pairs {};
+  for (const auto& [degree, node] : candidates) {
+    for (const auto& in : g.getIngoingEdgesOf(node)) {
+      for (const auto& out : g.getOutgoingEdgesOf(node)) {
+        if (in.end != out.end) {
+          pairs.push_back(EdgePair { in, out });
+        }
+      }
+    }
+    if (pairs.empty()) {
+      continue;
+    }
+    pairCount += pairs.size();
+    // Pairs of one node are sent together so a single thread contracts the whole node
+    extraNodes->queue.send(pairs);
+    if (pairCount >= maxPairs) {
+      break;
+    }
+  }
+  extraNodes->queue.close();
+}
+
+void Contractor::printMemoryReport(const Graph& g, MultiQueue<EdgePair>& queue)
+{
+  std::cout << "..."
+            << "Memory usage in round " << level << ":" << '\n';
+  printMemory("edges", Edge::memoryUsage());
+  printMemory("contracted edges", contractedEdges.capacity() * sizeof(EdgeId));
+  printMemory("contracted nodes", contractedNodes.capacity() * sizeof(Node));
+  printMemory("graph", g.memoryUsage());
+  printMemory("queue (peak)", queue.peakSize() * sizeof(EdgePair));
+  printMemory("workers (" + std::to_string(THREAD_COUNT) + ")", workerMemory);
+  if (witnessCache) {
+    printMemory("witness cache", witnessCache->memoryUsage());
+  }
+  if (HugePages::enabled()) {
+    printMemory("huge pages (advised)", HugePages::advised());
+    printMemory("huge pages (backed)", HugePages::backed());
+  }
+  printMemory("process rss", currentRss());
+  printMemory("process rss (peak)", peakRss());
+}
+
+void Contractor::setDeterministic(bool value) { deterministic = value; }
+
+void Contractor::setAsync(bool value) { async = value; }
+
+void Contractor::setPairBudget(const PairBudget& value) { pairBudget = value; }
+
+void Contractor::setConfigRegions(bool value)
+{
+  shortcutRegions = value ? std::make_unique<ShortcutRegions>() : nullptr;
+}
+
+void Contractor::setPinThreads(bool value)
+{
+  pinThreads = value;
+  if (pinThreads) {
+    for (size_t i = 0; i < lps.size(); ++i) {
+      lps[i]->pin(Placement::cpuOfWorker(i));
+    }
+  }
+}
+
+void Contractor::setWitnessCache(bool value)
+{
+  witnessCache = value ? std::make_unique<WitnessCache>() : nullptr;
+}
+
+void Contractor::freeze(std::unordered_set<NodeId>&& nodes) { frozenNodes = std::move(nodes); }
+
+void Contractor::addContracted(std::vector<Node>&& nodes, size_t level)
+{
+  std::move(nodes.begin(), nodes.end(), std::back_inserter(contractedNodes));
+  this->level = std::max(this->level, level);
+}
+
+const std::vector<Node>& Contractor::getContractedNodes() const { return contractedNodes; }
+
 Contractor::~Contractor() noexcept = default;
+
+} // namespace MULTI_CH_DIM_NAMESPACE
@@ -19,18 +19,34 @@
 #define CONTRACTOR_H
 
 #include "ndijkstra.hpp"
+#include <atomic>
+#include <chrono>
 #include <future>
 #include <set>
+#include <unordered_set>
 
 template <class T> class MultiQueue;
 
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
 class ContractionLp;
+struct ExtraNodes;
+struct ShortcutRegions;
+class WitnessCache;
 
 struct EdgePair {
   HalfEdge in;
   HalfEdge out;
 };
 
+// Limits the work spent on a single edge pair, zero means unlimited. A pair exceeding its
+// budget gets a shortcut.
+struct PairBudget {
+  size_t lpCalls = 0;
+  size_t constraints = 0;
+  std::chrono::milliseconds time { 0 };
+};
+
 class Contractor {
 
   public:
@@ -58,14 +74,49 @@ class Contractor {
   std::set<NodePos> reduce(std::set<NodePos>& set, const Graph& g);
   std::set<NodePos> reduce(std::set<NodePos>&& set, const Graph& g) { return reduce(set, g); };
 
+  // Makes the created shortcuts independent of the number of threads and their scheduling
+  void setDeterministic(bool value);
+  // Threads waiting for the end of a round contract further nodes of the independent set
+  void setAsync(bool value);
+  // Witness costs found for a pair of nodes are reused in later rounds
+  void setWitnessCache(bool value);
+  void setPairBudget(const PairBudget& value);
+  // Pins every worker and its LP process to a core and interleaves the graph over all NUMA
+  // nodes
+  void setPinThreads(bool value);
+  // Shortcuts store the configs for which they can be part of a shortest path
+  void setConfigRegions(bool value);
+
+  // Frozen nodes are never contracted, e.g. the boundary nodes of a partition cell
+  void freeze(std::unordered_set<NodeId>&& nodes);
+  // Adds nodes which were contracted elsewhere up to the given level
+  void addContracted(std::vector<Node>&& nodes, size_t level);
+  const std::vector<Node>& getContractedNodes() const;
+
   protected:
   private:
+  // Prints the bytes held by the main data structures of the current round
+  void printMemoryReport(const Graph& g, MultiQueue<EdgePair>& queue);
+  void sendExtraPairs(const Graph& g, const std::set<NodePos>& independent,
+      const std::set<NodePos>& set, size_t maxPairs);
+
   size_t level = 0;
   std::vector<Node> contractedNodes;
   std::vector<EdgeId> contractedEdges;
   bool printStatistics = false;
+  bool deterministic = false;
+  bool async = false;
+  std::unordered_set<NodeId> frozenNodes;
   const size_t THREAD_COUNT;
   std::vector<std::unique_ptr<ContractionLp>> lps;
+  std::atomic<size_t> workerMemory { 0 };
+  std::unique_ptr<ExtraNodes> extraNodes;
+  std::unique_ptr<WitnessCache> witnessCache;
+  PairBudget pairBudget;
+  bool pinThreads = false;
+  std::unique_ptr<ShortcutRegions> shortcutRegions;
 };
 
+} // namespace MULTI_CH_DIM_NAMESPACE
+
 #endif /* CONTRACTOR_H */
@@ -0,0 +1,186 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "costEnvelope.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+namespace {
+const size_t last = Cost::dim - 1;
+
+double epsilon(double bound) { return 1e-9 * std::max(1.0, std::abs(bound)); }
+}
+
+CostEnvelope::CostEnvelope(double lower, double upper)
+{
+  // c_i >= 0 for the free config values, their sum <= 1, then lower <= z <= upper
+  for (size_t i = 0; i < last; ++i) {
+    Row row {};
+    row[i] = -1;
+    rows.push_back(row);
+    bounds.push_back(0);
+  }
+  Row sum {};
+  std::fill(sum.begin(), sum.begin() + last, 1);
+  rows.push_back(sum);
+  bounds.push_back(1);
+  Row bottom {};
+  bottom[last] = -1;
+  rows.push_back(bottom);
+  bounds.push_back(-lower);
+  Row top {};
+  top[last] = 1;
+  rows.push_back(top);
+  bounds.push_back(upper);
+
+  // The prism over the config simplex, j == last is the corner with all free values 0
+  for (size_t j = 0; j <= last; ++j) {
+    std::vector<double> config(Cost::dim, 0);
+    config[j] = 1;
+    std::vector<size_t> tight;
+    for (size_t i = 0; i < last; ++i) {
+      if (i != j) {
+        tight.push_back(i);
+      }
+    }
+    if (j != last) {
+      tight.push_back(last);
+    }
+    for (size_t end : { last + 1, last + 2 }) {
+      auto withEnd = tight;
+      withEnd.push_back(end);
+      double z = end == last + 1 ? lower : upper;
+      corners.push_back(Corner { Vertex { config, z }, std::move(withEnd) });
+    }
+  }
+}
+
+double CostEnvelope::slack(size_t row, const Vertex& v) const
+{
+  double value = rows[row][last] * v.cost;
+  for (size_t i = 0; i < last; ++i) {
+    value += rows[row][i] * v.config[i];
+  }
+  return bounds[row] - value;
+}
+
+// Two corners share an edge if dim - 1 common rows are tight and no third corner lies on all
+// of them (the combinatorial test of the double description method)
+bool CostEnvelope::adjacent(const std::vector<size_t>& common, size_t a, size_t b) const
+{
+  if (common.size() + 1 < Cost::dim) {
+    return false;
+  }
+  for (size_t i = 0; i < corners.size(); ++i) {
+    if (i != a && i != b
+        && std::includes(corners[i].tight.begin(), corners[i].tight.end(), common.begin(),
+            common.end())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CostEnvelope::add(const std::array<double, Cost::dim>& cost)
+{
+  // z <= cost * c with c_last = 1 - sum of the free values
+  Row row {};
+  for (size_t i = 0; i < last; ++i) {
+    row[i] = -(cost[i] - cost[last]);
+  }
+  row[last] = 1;
+  rows.push_back(row);
+  bounds.push_back(cost[last]);
+  const size_t index = rows.size() - 1;
+  const double eps = epsilon(cost[last]);
+
+  std::vector<double> slacks;
+  std::vector<size_t> cut;
+  std::vector<size_t> kept;
+  for (size_t i = 0; i < corners.size(); ++i) {
+    slacks.push_back(slack(index, corners[i].vertex));
+    if (slacks[i] < -eps) {
+      cut.push_back(i);
+    } else if (slacks[i] > eps) {
+      kept.push_back(i);
+    }
+  }
+
+  std::vector<Corner> result;
+  for (size_t k : kept) {
+    result.push_back(corners[k]);
+  }
+  for (size_t i = 0; i < corners.size(); ++i) {
+    if (std::abs(slacks[i]) <= eps) {
+      result.push_back(corners[i]);
+      result.back().tight.push_back(index);
+    }
+  }
+  if (cut.empty()) {
+    corners = std::move(result);
+    return false;
+  }
+
+  for (size_t out : cut) {
+    for (size_t in : kept) {
+      std::vector<size_t> common;
+      std::set_intersection(corners[out].tight.begin(), corners[out].tight.end(),
+          corners[in].tight.begin(), corners[in].tight.end(), std::back_inserter(common));
+      if (!adjacent(common, out, in)) {
+        continue;
+      }
+      const auto& from = corners[out].vertex;
+      const auto& to = corners[in].vertex;
+      double t = slacks[out] / (slacks[out] - slacks[in]);
+      Vertex v { std::vector<double>(Cost::dim, 0), from.cost + t * (to.cost - from.cost) };
+      for (size_t i = 0; i < Cost::dim; ++i) {
+        v.config[i] = std::max(0.0, from.config[i] + t * (to.config[i] - from.config[i]));
+      }
+      common.push_back(index);
+      result.push_back(Corner { std::move(v), std::move(common) });
+    }
+  }
+  corners = std::move(result);
+  return true;
+}
+
+std::vector<CostEnvelope::Vertex> CostEnvelope::vertices() const
+{
+  const size_t firstFunction = last + 3;
+  std::vector<Vertex> result;
+  for (const auto& corner : corners) {
+    if (corner.tight.back() >= firstFunction) {
+      result.push_back(corner.vertex);
+    }
+  }
+  return result;
+}
+
+std::optional<CostEnvelope::Vertex> CostEnvelope::maximum() const
+{
+  auto best = std::max_element(corners.begin(), corners.end(),
+      [](const Corner& a, const Corner& b) { return a.vertex.cost < b.vertex.cost; });
+  if (best == corners.end()) {
+    return {};
+  }
+  return best->vertex;
+}
+
+} // namespace MULTI_CH_DIM_NAMESPACE
@@ -0,0 +1,73 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef COSTENVELOPE_H
+#define COSTENVELOPE_H
+
+#include "graph.hpp"
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+// The minimum of linear cost functions over the config simplex, kept as the vertices of the
+// polytope below it. Points of the polytope are the first dim - 1 config values and a cost z
+// with lower <= z <= upper and z <= f * c for every added cost function f. Adding a function
+// only cuts off the vertices above it and creates the new ones on the edges to the remaining
+// vertices (one step of the double description method), so the vertices are never enumerated
+// from scratch. Both the config sweep and the LP of the contraction (maximize z) work on it.
+class CostEnvelope {
+  public:
+  struct Vertex {
+    std::vector<double> config;
+    double cost;
+  };
+
+  // lower has to be below and upper above every added function on the whole simplex
+  CostEnvelope(double lower, double upper);
+  CostEnvelope(const CostEnvelope& other) = default;
+  CostEnvelope(CostEnvelope&& other) = default;
+  virtual ~CostEnvelope() noexcept = default;
+  CostEnvelope& operator=(const CostEnvelope& other) = default;
+  CostEnvelope& operator=(CostEnvelope&& other) = default;
+
+  // Returns false if the function is nowhere below the polytope
+  bool add(const std::array<double, Cost::dim>& cost);
+
+  // Vertices on one of the added functions, the minimum is linear between them
+  std::vector<Vertex> vertices() const;
+  // Vertex with the highest cost, empty if the polytope is empty
+  std::optional<Vertex> maximum() const;
+
+  private:
+  using Row = std::array<double, Cost::dim>;
+  struct Corner {
+    Vertex vertex;
+    // Sorted indices of the rows the corner lies on
+    std::vector<size_t> tight;
+  };
+
+  double slack(size_t row, const Vertex& v) const;
+  bool adjacent(const std::vector<size_t>& common, size_t a, size_t b) const;
+
+  // a * (c_0, ..., c_{dim - 2}, z) <= b, the first dim + 2 rows are the bounds
+  std::vector<Row> rows;
+  std::vector<double> bounds;
+  std::vector<Corner> corners;
+};
+
+} // namespace MULTI_CH_DIM_NAMESPACE
+
+#endif /* COSTENVELOPE_H */
@@ -16,14 +16,19 @@
   along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include "dijkstra.hpp"
+#include "prefetch.hpp"
+#include <algorithm>
 #include <queue>
+#include <tuple>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
 
 const double dmax = std::numeric_limits<double>::max();
 const Cost maxCost { std::vector<double>(Cost::dim, dmax) };
 
 Dijkstra::Dijkstra(Graph* g, size_t nodeCount)
-    : costS(nodeCount, dmax)
-    , costT(nodeCount, dmax)
+    : costS(nodeCount, SharedCost { dmax })
+    , costT(nodeCount, SharedCost { dmax })
     , graph(g)
 {
 }
@@ -63,14 +68,14 @@ void insertUnpackedEdge(const Edge& e, std::deque<Edge>& route, bool front)
   }
 }
 
-Route Dijkstra::buildRoute(NodePos node, NodeToEdgeMap previousEdgeS, NodeToEdgeMap previousEdgeT,
-    NodePos from, NodePos to)
+Route Dijkstra::buildRoute(NodePos node, const NodeToEdgeMap& previousEdgeS,
+    const NodeToEdgeMap& previousEdgeT, NodePos from, NodePos to)
 {
 
   Route route {};
   auto curNode = node;
   while (curNode != from) {
-    const auto& edge = previousEdgeS[curNode];
+    const auto& edge = previousEdgeS.at(curNode);
     route.costs = route.costs + edge.cost;
     insertUnpackedEdge(Edge::getEdge(edge.id), route.edges, true);
     curNode = edge.begin;
@@ -78,7 +83,7 @@ Route Dijkstra::buildRoute(NodePos node, NodeToEdgeMap previousEdgeS, NodeToEdge
 
   curNode = node;
   while (curNode != to) {
-    const auto& edge = previousEdgeT[curNode];
+    const auto& edge = previousEdgeT.at(curNode);
     route.costs = route.costs + edge.cost;
     insertUnpackedEdge(Edge::getEdge(edge.id), route.edges, false);
     curNode = edge.begin;
@@ -99,6 +104,9 @@ std::optional<Route> Dijkstra::findBestRoute(NodePos from, NodePos to, Config co
 
   clearState();
   this->config = config;
+  if (parallel) {
+    return findBestRouteInParallel(from, to);
+  }
   Dijkstra::Queue heapS { QueueComparator {} };
 
   heapS.push(std::make_pair(from, 0));
@@ -156,7 +164,7 @@ std::optional<Route> Dijkstra::findBestRoute(NodePos from, NodePos to, Config co
         }
       }
 
-      relaxEdges(node, cost, Direction::S, heapS, previousEdgeS);
+      relaxedEdges += relaxEdges(node, cost, Direction::S, heapS, previousEdgeS);
     }
 
     if (!heapT.empty() && !tBigger) {
@@ -181,15 +189,218 @@ std::optional<Route> Dijkstra::findBestRoute(NodePos from, NodePos to, Config co
           minNode = node;
         }
       }
-      relaxEdges(node, cost, Direction::T, heapT, previousEdgeT);
+      relaxedEdges += relaxEdges(node, cost, Direction::T, heapT, previousEdgeT);
+    }
+  }
+}
+
+std::optional<Route> Dijkstra::findBestRouteInParallel(NodePos from, NodePos to)
+{
+  Queue heapS { QueueComparator {} };
+  heapS.push(std::make_pair(from, 0));
+  touchedS.push_back(from);
+  costS[from] = 0;
+  NodeToEdgeMap previousEdgeS {};
+
+  Queue heapT { QueueComparator {} };
+  heapT.push(std::make_pair(to, 0));
+  touchedT.push_back(to);
+  costT[to] = 0;
+  NodeToEdgeMap previousEdgeT {};
+
+  std::atomic<double> minCandidate = dmax;
+  size_t popsS = 0;
+  size_t popsT = 0;
+  size_t relaxedS = 0;
+  size_t relaxedT = 0;
+  backward.start(
+      [&] { search(Direction::T, heapT, previousEdgeT, minCandidate, popsT, relaxedT); });
+  search(Direction::S, heapS, previousEdgeS, minCandidate, popsS, relaxedS);
+  backward.wait();
+  pqPops += popsS + popsT;
+  relaxedEdges += relaxedS + relaxedT;
+
+  // The searches only see each others costs eventually, so the meeting node is chosen after
+  // both are done. Every touched node is the end of a path found by its search.
+  double best = dmax;
+  std::optional<NodePos> minNode = {};
+  for (auto node : touchedS) {
+    if (costT[node] != dmax && costS[node] + costT[node] < best) {
+      best = costS[node] + costT[node];
+      minNode = node;
     }
   }
+  if (minNode) {
+    return buildRoute(*minNode, previousEdgeS, previousEdgeT, from, to);
+  }
+  return {};
 }
 
-void Dijkstra::relaxEdges(
+void Dijkstra::search(Direction dir, Queue& heap, NodeToEdgeMap& previousEdge,
+    std::atomic<double>& minCandidate, size_t& pops, size_t& relaxed, double slack)
+{
+  auto& costs = dir == Direction::S ? costS : costT;
+  const auto& otherCosts = dir == Direction::S ? costT : costS;
+  while (!heap.empty()) {
+    auto [node, cost] = heap.top();
+    heap.pop();
+    ++pops;
+    if (cost > costs[node]) {
+      continue;
+    }
+    if (stallOnDemand(node, cost, dir)) {
+      continue;
+    }
+    if (cost > slack * minCandidate.load(std::memory_order_relaxed)) {
+      return;
+    }
+    double other = otherCosts[node];
+    if (other != dmax) {
+      double candidate = cost + other;
+      double current = minCandidate.load(std::memory_order_relaxed);
+      while (candidate < current
+          && !minCandidate.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+      }
+    }
+    relaxed += relaxEdges(node, cost, dir, heap, previousEdge);
+  }
+}
+
+// Admissibility of alternatives as in Abraham et al., Alternative Routes in Road Networks
+const double maxStretch = 1.25;
+const double maxSharing = 0.8;
+const double localOptimality = 0.25;
+const size_t candidatesPerAlternative = 16;
+
+std::vector<Route> Dijkstra::findAlternativeRoutes(
+    NodePos from, NodePos to, Config config, size_t count)
+{
+  clearState();
+  this->config = config;
+
+  Queue heapS { QueueComparator {} };
+  heapS.push(std::make_pair(from, 0));
+  touchedS.push_back(from);
+  costS[from] = 0;
+  NodeToEdgeMap previousEdgeS {};
+
+  Queue heapT { QueueComparator {} };
+  heapT.push(std::make_pair(to, 0));
+  touchedT.push_back(to);
+  costT[to] = 0;
+  NodeToEdgeMap previousEdgeT {};
+
+  // The forward search has no bound yet and runs through its whole search space
+  std::atomic<double> minCandidate = dmax;
+  size_t pops = 0;
+  size_t relaxed = 0;
+  search(Direction::S, heapS, previousEdgeS, minCandidate, pops, relaxed);
+  search(Direction::T, heapT, previousEdgeT, minCandidate, pops, relaxed, maxStretch);
+  pqPops += pops;
+  relaxedEdges += relaxed;
+
+  std::vector<std::pair<double, NodePos>> candidates;
+  for (auto node : touchedT) {
+    if (costS[node] != dmax) {
+      candidates.emplace_back(costS[node] + costT[node], node);
+    }
+  }
+  if (candidates.empty()) {
+    return {};
+  }
+  std::sort(candidates.begin(), candidates.end());
+  double best = candidates.front().first;
+  candidates.erase(std::unique(candidates.begin(), candidates.end(),
+                       [](const auto& a, const auto& b) { return a.second == b.second; }),
+      candidates.end());
+  if (candidates.size() > 1 + count * candidatesPerAlternative) {
+    candidates.resize(1 + count * candidatesPerAlternative);
+  }
+
+  std::vector<Route> result { buildRoute(candidates.front().second, previousEdgeS,
+      previousEdgeT, from, to) };
+  std::unordered_set<EdgeId> usedEdges;
+  for (const auto& e : result.front().edges) {
+    usedEdges.insert(e.getId());
+  }
+
+  // Ranks the admissible candidates by length and sharing before the local optimality test
+  std::vector<std::tuple<double, NodePos, Route>> ranked;
+  for (size_t i = 1; i < candidates.size(); ++i) {
+    auto [length, via] = candidates[i];
+    if (length > maxStretch * best) {
+      break;
+    }
+    auto route = buildRoute(via, previousEdgeS, previousEdgeT, from, to);
+    double shared = 0;
+    for (const auto& e : route.edges) {
+      if (usedEdges.count(e.getId()) > 0) {
+        shared += e.costByConfiguration(config);
+      }
+    }
+    if (shared <= maxSharing * best) {
+      ranked.emplace_back(2 * length + shared, via, std::move(route));
+    }
+  }
+  std::sort(ranked.begin(), ranked.end(),
+      [](const auto& a, const auto& b) { return std::get<0>(a) < std::get<0>(b); });
+
+  size_t tests = 0;
+  for (auto& [rank, via, route] : ranked) {
+    if (result.size() > count || tests >= 3 * count) {
+      break;
+    }
+    // Candidates of accepted alternatives share too much with them
+    double shared = 0;
+    for (const auto& e : route.edges) {
+      if (usedEdges.count(e.getId()) > 0) {
+        shared += e.costByConfiguration(config);
+      }
+    }
+    if (shared > maxSharing * best) {
+      continue;
+    }
+    ++tests;
+    if (!locallyOptimal(route, via, best)) {
+      continue;
+    }
+    for (const auto& e : route.edges) {
+      usedEdges.insert(e.getId());
+    }
+    result.push_back(std::move(route));
+  }
+  return result;
+}
+
+bool Dijkstra::locallyOptimal(const Route& route, NodePos via, double length)
+{
+  const auto& edges = route.edges;
+  auto viaEdge = std::find_if(
+      edges.begin(), edges.end(), [via](const Edge& e) { return e.destPos() == via; });
+  if (viaEdge == edges.end()) {
+    return true;
+  }
+  double part = 0;
+  auto first = viaEdge + 1;
+  while (first != edges.begin() && part < localOptimality * length) {
+    --first;
+    part += first->costByConfiguration(config);
+  }
+  double rest = 0;
+  auto last = viaEdge + 1;
+  while (last != edges.end() && rest < localOptimality * length) {
+    rest += last->costByConfiguration(config);
+    ++last;
+  }
+  auto shortest = findBestRoute(first->sourcePos(), (last - 1)->destPos(), config);
+  return shortest && part + rest <= shortest->costs * config + COST_ACCURACY * length;
+}
+
+size_t Dijkstra::relaxEdges(
     const NodePos& node, double cost, Direction dir, Queue& heap, NodeToEdgeMap& previousEdge)
 {
-  std::vector<double>& costs = dir == Direction::S ? costS : costT;
+  size_t relaxed = 0;
+  auto& costs = dir == Direction::S ? costS : costT;
   std::vector<NodePos>& touched = dir == Direction::S ? touchedS : touchedT;
 
   auto myLevel = graph->getLevelOf(node);
@@ -199,6 +410,11 @@ void Dijkstra::relaxEdges(
   std::optional<NodePos> lastNode = {};
   std::optional<double> lastCost = {};
   std::optional<HalfEdge> lastEdge = {};
+  if constexpr (prefetching) {
+    for (const auto& edge : edges) {
+      prefetch(&costs[edge.end]);
+    }
+  }
   for (const auto& edge : edges) {
     NodePos nextNode = edge.end;
     if (graph->getLevelOf(nextNode) < myLevel) {
@@ -208,7 +424,7 @@ void Dijkstra::relaxEdges(
       lastNode = nextNode;
     }
     if (*lastNode != nextNode) {
-      if (*lastCost < costs[*lastNode]) {
+      if (lastCost && *lastCost < costs[*lastNode]) {
         costs[*lastNode] = *lastCost;
         touched.push_back(*lastNode);
         previousEdge[*lastNode] = *lastEdge;
@@ -218,6 +434,13 @@ void Dijkstra::relaxEdges(
       lastCost = {};
       lastEdge = {};
     }
+    if (useConfigRegions) {
+      const auto* region = Edge::getConfigRegion(edge.id);
+      if (region && !region->contains(config)) {
+        continue;
+      }
+    }
+    ++relaxed;
     double nextCost = cost + edge.costByConfiguration(config);
     if (!lastCost || *lastCost > nextCost) {
       lastCost = nextCost;
@@ -232,8 +455,13 @@ void Dijkstra::relaxEdges(
       heap.push({ *lastNode, *lastCost });
     }
   }
+  return relaxed;
 }
 
+void Dijkstra::pruneByConfigRegion(bool value) { useConfigRegions = value; }
+
+void Dijkstra::searchInParallel(bool value) { parallel = value; }
+
 bool Dijkstra::stallOnDemand(const NodePos& node, double cost, Direction dir)
 {
   auto myLevel = graph->getLevelOf(node);
@@ -277,3 +505,5 @@ Config generateRandomConfig()
   confValues.push_back(configLeft);
   return Config { confValues };
 }
+
+} // namespace MULTI_CH_DIM_NAMESPACE
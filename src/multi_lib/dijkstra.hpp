@@ -19,11 +19,15 @@
 #define DIJKSTRA_H
 
 #include "graph.hpp"
+#include "helperThread.hpp"
+#include <atomic>
 #include <cmath>
 #include <iostream>
 #include <queue>
 #include <random>
 
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
 using LengthConfig = NamedType<double, struct LengthConfigParameter>;
 using HeightConfig = NamedType<double, struct HeightConfigParameter>;
 using UnsuitabilityConfig = NamedType<double, struct UnsuitabilityConfigParameter>;
@@ -91,9 +95,46 @@ class Dijkstra {
 
   std::optional<Route> findBestRoute(NodePos from, NodePos to, Config config);
 
+  // The best route followed by up to count alternatives with limited sharing, bounded stretch
+  // and local optimality. The via nodes are taken from the full forward and backward search.
+  std::vector<Route> findAlternativeRoutes(
+      NodePos from, NodePos to, Config config, size_t count = 2);
+
+  // Skips shortcuts whose config region does not contain the config of the query
+  void pruneByConfigRegion(bool value);
+
+  // Runs the backward search on a second thread
+  void searchInParallel(bool value);
+
   size_t pqPops = 0;
+  size_t relaxedEdges = 0;
 
   private:
+  // Node cost which the other search of a parallel query may read while it is written. Relaxed
+  // loads and stores compile to plain moves, so the sequential query does not pay for it.
+  struct SharedCost {
+    std::atomic<double> value;
+    SharedCost(double value)
+        : value(value)
+    {
+    }
+    SharedCost(const SharedCost& other)
+        : value(other.value.load(std::memory_order_relaxed))
+    {
+    }
+    SharedCost& operator=(const SharedCost& other)
+    {
+      value.store(other.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      return *this;
+    }
+    SharedCost& operator=(double cost)
+    {
+      value.store(cost, std::memory_order_relaxed);
+      return *this;
+    }
+    operator double() const { return value.load(std::memory_order_relaxed); }
+  };
+
   using QueueElem = std::pair<NodePos, double>;
   struct QueueComparator {
     bool operator()(QueueElem left, QueueElem right);
@@ -103,22 +144,36 @@ class Dijkstra {
   void clearState();
 
   using NodeToEdgeMap = std::unordered_map<NodePos, HalfEdge>;
-  Route buildRoute(NodePos node, NodeToEdgeMap previousEdgeS, NodeToEdgeMap previousEdgeT,
-      NodePos from, NodePos to);
+  Route buildRoute(NodePos node, const NodeToEdgeMap& previousEdgeS,
+      const NodeToEdgeMap& previousEdgeT, NodePos from, NodePos to);
 
   enum class Direction { S, T };
 
-  void relaxEdges(
+  std::optional<Route> findBestRouteInParallel(NodePos from, NodePos to);
+  // Runs one direction until its queue exceeds slack times the shared best candidate
+  void search(Direction dir, Queue& heap, NodeToEdgeMap& previousEdge,
+      std::atomic<double>& minCandidate, size_t& pops, size_t& relaxed, double slack = 1);
+  // True if the part of the route around the via node is a shortest path
+  bool locallyOptimal(const Route& route, NodePos via, double length);
+
+  // Returns the number of relaxed edges
+  size_t relaxEdges(
       const NodePos& node, double cost, Direction dir, Queue& heap, NodeToEdgeMap& previousEdge);
 
   bool stallOnDemand(const NodePos& node, double cost, Direction dir);
 
-  std::vector<double> costS;
-  std::vector<double> costT;
+  bool useConfigRegions = false;
+  bool parallel = false;
+  // Runs the backward search of parallel queries
+  HelperThread backward;
+  std::vector<SharedCost> costS;
+  std::vector<SharedCost> costT;
   std::vector<NodePos> touchedS;
   std::vector<NodePos> touchedT;
   Config config = Config(std::vector(Cost::dim, 0.0));
   Graph* graph;
 };
 
+} // namespace MULTI_CH_DIM_NAMESPACE
+
 #endif /* DIJKSTRA_H */
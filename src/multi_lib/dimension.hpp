@@ -0,0 +1,33 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef DIMENSION_H
+#define DIMENSION_H
+
+// Everything depending on GRAPH_DIM lives in the inline namespace dim<GRAPH_DIM>. Code using
+// it does not notice, but libraries compiled for different dimensions can be linked into the
+// same binary (see src/dispatch.cpp).
+#define MULTI_CH_CONCAT_(a, b) a##b
+#define MULTI_CH_CONCAT(a, b) MULTI_CH_CONCAT_(a, b)
+#define MULTI_CH_DIM_NAMESPACE MULTI_CH_CONCAT(dim, GRAPH_DIM)
+
+#include <cstddef>
+
+// The multi file format has no dimension line, its edges carry length, height and unsuitability
+constexpr size_t multiFileDimension = 3;
+
+#endif /* DIMENSION_H */
@@ -17,12 +17,16 @@
 */
 #include "dijkstra.hpp"
 #include "graph.hpp"
+#include "placement.hpp"
 #include <algorithm>
 #include <cassert>
 #include <cstdlib>
 #include <sstream>
 
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
 std::vector<Edge> Edge::edges {};
+std::vector<std::unique_ptr<const ConfigRegion>> Edge::regions {};
 
 Edge::Edge(NodeId source, NodeId dest)
     : Edge(source, dest, {}, {})
@@ -153,6 +157,41 @@ const std::string& Edge::external_id() const { return external_id_; }
 
 double HalfEdge::costByConfiguration(const Config& conf) const { return cost * conf; }
 
+bool ConfigRegion::contains(const Config& conf) const
+{
+  for (size_t i = 0; i < count; ++i) {
+    // Not Cost::operator* which rejects negative costs
+    double value = 0;
+    for (size_t j = 0; j < Cost::dim; ++j) {
+      value += halfSpaces[i].values[j] * conf.values[j];
+    }
+    if (value < -COST_ACCURACY) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Edge::setConfigRegion(EdgeId id, const ConfigRegion& region)
+{
+  if (regions.size() <= id) {
+    regions.resize(id + 1);
+  }
+  regions[id] = std::make_unique<const ConfigRegion>(region);
+}
+
+void Edge::clearConfigRegion(EdgeId id)
+{
+  if (id < regions.size()) {
+    regions[id].reset();
+  }
+}
+
+const ConfigRegion* Edge::getConfigRegion(EdgeId id)
+{
+  return id < regions.size() ? regions[id].get() : nullptr;
+}
+
 std::vector<EdgeId> Edge::administerEdges(std::vector<Edge>&& edges)
 {
   std::vector<EdgeId> ids;
@@ -182,6 +221,36 @@ std::vector<EdgeId> Edge::administerEdges(std::vector<Edge>&& edges)
 const Edge& Edge::getEdge(EdgeId id) { return edges.at(id); }
 Edge& Edge::getMutEdge(EdgeId id) { return edges.at(id); }
 
+size_t Edge::memoryUsage()
+{
+  const size_t inlineCapacity = std::string().capacity();
+  size_t bytes = edges.capacity() * sizeof(Edge);
+  bytes += regions.capacity() * sizeof(regions[0]);
+  for (const auto& region : regions) {
+    if (region) {
+      bytes += sizeof(ConfigRegion);
+    }
+  }
+  for (const auto& e : edges) {
+    if (e.external_id_.capacity() > inlineCapacity) {
+      bytes += e.external_id_.capacity() + 1;
+    }
+  }
+  return bytes;
+}
+
+void Edge::interleaveMemory()
+{
+  // The policy covers the whole capacity, so appended edges are placed when they are first
+  // touched and only a reallocated array has to be moved
+  static const Edge* interleaved = nullptr;
+  if (edges.data() == interleaved) {
+    return;
+  }
+  interleaved = edges.data();
+  Placement::interleave(edges.data(), edges.data() + edges.capacity());
+}
+
 double Cost::operator*(const Config& conf) const
 {
   double combinedCost = 0;
@@ -244,3 +313,5 @@ bool Edge::use_external_edge_ids_ = false;
 
 void Edge::write_osm_id_of_nodes(bool value) { use_node_osm_ids_ = value; }
 void Edge::use_external_edge_ids(bool value) { use_external_edge_ids_ = value; }
+
+} // namespace MULTI_CH_DIM_NAMESPACE
@@ -16,12 +16,16 @@
   along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include "grid.hpp"
 #include "ndijkstra.hpp"
+#include "placement.hpp"
 #include <future>
 #include <iomanip>
 
 #include <boost/property_map/property_map.hpp>
 
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
 void Graph::connectEdgesToNodes(const std::vector<Node>& nodes, const std::vector<EdgeId>& edges)
 {
   if (nodes.empty()) {
@@ -50,7 +54,7 @@ void Graph::connectEdgesToNodes(const std::vector<Node>& nodes, const std::vecto
 }
 
 enum class Pos { source, dest };
-void sortEdgesByNodePos(std::vector<HalfEdge>& edges, const Graph& g)
+void sortEdgesByNodePos(HugeVector<HalfEdge>& edges, const Graph& g)
 {
   auto comparator = [&g](const HalfEdge& a, const HalfEdge& b) {
     if (a.begin == b.begin) {
@@ -67,7 +71,7 @@ void sortEdgesByNodePos(std::vector<HalfEdge>& edges, const Graph& g)
 }
 
 void calculateOffsets(
-    std::vector<HalfEdge>& edges, std::vector<NodeOffset>& offsets, Pos p, const Graph& g)
+    HugeVector<HalfEdge>& edges, HugeVector<NodeOffset>& offsets, Pos p, const Graph& g)
 {
   auto sourcePos = [&edges](size_t j) { return edges[j].begin; };
   auto destPos = [&edges](size_t j) { return edges[j].begin; };
@@ -156,7 +160,7 @@ std::ostream& operator<<(std::ostream& s, const Graph& g)
   return s;
 }
 
-std::vector<NodeOffset> const& Graph::getOffsets() const { return offsets; }
+HugeVector<NodeOffset> const& Graph::getOffsets() const { return offsets; }
 
 Dijkstra Graph::createDijkstra() { return Dijkstra { this, nodes.size() }; }
 
@@ -165,6 +169,8 @@ NormalDijkstra Graph::createNormalDijkstra(bool unpack)
   return NormalDijkstra { this, nodes.size(), unpack };
 }
 
+Grid Graph::createGrid(long sideLength) const { return Grid { *this, sideLength }; }
+
 size_t readCount(std::istream& file)
 {
   std::string line;
@@ -236,6 +242,25 @@ EdgeRange Graph::getIngoingEdgesOf(NodePos pos) const
 
 size_t Graph::getLevelOf(NodePos pos) const { return level[pos]; }
 
+void Graph::refreshEdges(const std::vector<EdgeId>& ids)
+{
+  for (const auto& id : ids) {
+    const auto& e = Edge::getEdge(id);
+    auto source = e.sourcePos();
+    auto dest = e.destPos();
+    for (size_t i = offsets[source].out; i < offsets[source + 1].out; ++i) {
+      if (outEdges[i].id == id) {
+        outEdges[i] = e.makeHalfEdge(source, dest);
+      }
+    }
+    for (size_t i = offsets[dest].in; i < offsets[dest + 1].in; ++i) {
+      if (inEdges[i].id == id) {
+        inEdges[i] = e.makeHalfEdge(dest, source);
+      }
+    }
+  }
+}
+
 std::optional<NodePos> Graph::nodePosById(NodeId id) const
 {
   for (size_t i = 0; i < nodes.size(); ++i) {
@@ -256,6 +281,22 @@ size_t Graph::getInTimesOutDegree(NodePos node) const
   return offset.in * offset.out;
 }
 
+size_t Graph::memoryUsage() const
+{
+  return nodes.capacity() * sizeof(Node) + offsets.capacity() * sizeof(NodeOffset)
+      + (inEdges.capacity() + outEdges.capacity()) * sizeof(HalfEdge)
+      + level.capacity() * sizeof(size_t);
+}
+
+void Graph::interleaveMemory() const
+{
+  Placement::interleave(nodes);
+  Placement::interleave(offsets);
+  Placement::interleave(inEdges);
+  Placement::interleave(outEdges);
+  Placement::interleave(level);
+}
+
 std::unordered_map<NodeId, const Node*> Graph::getNodePosByIds(
     const std::unordered_set<NodeId>& ids) const
 {
@@ -309,3 +350,5 @@ void Graph::writeToStream(std::ostream& out) const
     edge.writeToStream(out);
   }
 }
+
+} // namespace MULTI_CH_DIM_NAMESPACE
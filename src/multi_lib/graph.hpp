@@ -18,17 +18,22 @@
 #ifndef GRAPH_H
 #define GRAPH_H
 
+#include "dimension.hpp"
+#include "hugePages.hpp"
 #include "namedType.hpp"
 
 #include <atomic>
 #include <boost/property_map/dynamic_property_map.hpp>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <set>
 #include <unordered_set>
 #include <vector>
 
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
 boost::dynamic_properties& get_graph_properties();
 
 using OsmId = NamedType<size_t, struct OsmIdParameter>;
@@ -139,6 +144,17 @@ struct NodeOffset {
 
 using ReplacedEdge = std::optional<EdgeId>;
 
+// Configs for which a shortcut can be part of a shortest path. Every half space is the cost of
+// a witness path between the end nodes of the shortcut minus the cost of the shortcut. Where
+// the witness is cheaper the shortcut is never needed.
+struct ConfigRegion {
+  static const size_t maxHalfSpaces = 2;
+  std::array<Cost, maxHalfSpaces> halfSpaces;
+  size_t count = 0;
+
+  bool contains(const Config& conf) const;
+};
+
 class Edge {
   public:
   Edge() = default;
@@ -172,11 +188,20 @@ class Edge {
 
   HalfEdge makeHalfEdge(NodePos begin, NodePos end) const;
 
+  static void setConfigRegion(EdgeId id, const ConfigRegion& region);
+  static void clearConfigRegion(EdgeId id);
+  // Null if the edge is needed for every config
+  static const ConfigRegion* getConfigRegion(EdgeId id);
+
   static Edge createFromText(const std::string& text);
   void writeToStream(std::ostream& out) const;
   static std::vector<EdgeId> administerEdges(std::vector<Edge>&& edges);
   static const Edge& getEdge(EdgeId id);
   static Edge& getMutEdge(EdgeId id);
+  // Bytes allocated for all administered edges including their external ids
+  static size_t memoryUsage();
+  // Spreads the edges over all NUMA nodes, a reallocated edge array is moved again
+  static void interleaveMemory();
 
   static void write_osm_id_of_nodes(bool value);
   static void use_external_edge_ids(bool value);
@@ -204,6 +229,8 @@ class Edge {
 
   public:
   static std::vector<Edge> edges;
+  // Config regions of the shortcuts by their id, empty unless a contraction stored regions
+  static std::vector<std::unique_ptr<const ConfigRegion>> regions;
 };
 
 class Node {
@@ -258,7 +285,7 @@ class Graph {
 
   friend std::ostream& operator<<(std::ostream& /*s*/, const Graph& /*g*/);
 
-  std::vector<NodeOffset> const& getOffsets() const;
+  HugeVector<NodeOffset> const& getOffsets() const;
   Dijkstra createDijkstra();
   NormalDijkstra createNormalDijkstra(bool unpack = false);
   Grid createGrid(long sideLength = 100) const;
@@ -279,6 +306,14 @@ class Graph {
 
   size_t getInTimesOutDegree(NodePos node) const;
 
+  // Copies the current cost of the edges into the in and out edge arrays
+  void refreshEdges(const std::vector<EdgeId>& ids);
+
+  // Bytes allocated for nodes, offsets and the in/out edge arrays
+  size_t memoryUsage() const;
+  // Spreads nodes, offsets and the in/out edge arrays over all NUMA nodes
+  void interleaveMemory() const;
+
   std::unordered_map<NodeId, const Node*> getNodePosByIds(
       const std::unordered_set<NodeId>& ids) const;
 
@@ -289,16 +324,16 @@ class Graph {
   void connectEdgesToNodes(const std::vector<Node>& nodes, const std::vector<EdgeId>& edges);
 
   std::vector<Node> nodes;
-  std::vector<NodeOffset> offsets;
-  std::vector<HalfEdge> inEdges;
-  std::vector<HalfEdge> outEdges;
-  std::vector<size_t> level;
+  HugeVector<NodeOffset> offsets;
+  HugeVector<HalfEdge> inEdges;
+  HugeVector<HalfEdge> outEdges;
+  HugeVector<size_t> level;
   size_t edgeCount;
 };
 
 class EdgeRange {
   public:
-  using iterator = std::vector<HalfEdge>::const_iterator;
+  using iterator = HugeVector<HalfEdge>::const_iterator;
 
   EdgeRange(iterator begin, iterator end)
       : begin_(begin)
@@ -325,4 +360,7 @@ struct Route;
 
 void printRoutes(std::ofstream& dotFile, const Graph& graph, const RouteWithCount& route1,
     const Route& route2, const Config& config, const std::set<NodePos>& set = {});
+
+} // namespace MULTI_CH_DIM_NAMESPACE
+
 #endif /* GRAPH_H */
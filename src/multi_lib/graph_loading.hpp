@@ -23,6 +23,8 @@
 #include <fstream>
 #include <iostream>
 
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
 using ms = std::chrono::milliseconds;
 namespace iostr = boost::iostreams;
 
@@ -54,7 +56,7 @@ Node createNode(std::ifstream& graph, std::ifstream& labels)
 Edge createEdge(std::ifstream& ch, std::ifstream& skips)
 {
 
-  if constexpr (Cost::dim == 3) {
+  if constexpr (Cost::dim == multiFileDimension) {
     size_t source, dest;
     double length, height, unsuitability;
     long edgeA, edgeB;
@@ -169,3 +171,5 @@ Graph loadGraphFromTextFile(std::string& graphPath, bool zipped)
             << "ms" << '\n';
   return g;
 }
+
+} // namespace MULTI_CH_DIM_NAMESPACE
@@ -13,6 +13,8 @@
 #include <iostream>
 #include <utility>
 
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
 template <class Graph> class dynamic_property_store {
   public:
   using vert_id = typename boost::graph_traits<Graph>::vertex_descriptor;
@@ -219,4 +221,6 @@ void write_graphml(std::ostream& outfile, const Graph& g)
   boost::write_graphml(outfile, boost_graph, graph_properties);
 }
 
+} // namespace MULTI_CH_DIM_NAMESPACE
+
 #endif /* GRAPHML_H */
@@ -0,0 +1,162 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "grid.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+#include <boost/property_map/property_map.hpp>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+Grid::Grid(const Graph& g, long sideLength)
+    : sideLength(sideLength)
+    , cellOffsets(sideLength * sideLength + 1, 0)
+{
+  if (sideLength < 1) {
+    throw std::invalid_argument("grid needs at least one cell");
+  }
+  std::vector<double> nodeLats(g.getNodeCount());
+  std::vector<double> nodeLngs(g.getNodeCount());
+  try {
+    for (size_t i = 0; i < g.getNodeCount(); ++i) {
+      auto [lat, lng] = coordinatesOf(g, NodePos { i });
+      nodeLats[i] = lat;
+      nodeLngs[i] = lng;
+    }
+  } catch (std::exception& e) {
+    throw std::invalid_argument("grid needs the coordinates of all nodes");
+  }
+  if (nodeLats.empty()) {
+    return;
+  }
+
+  auto [minLat, maxLat] = std::minmax_element(nodeLats.begin(), nodeLats.end());
+  auto [minLng, maxLng] = std::minmax_element(nodeLngs.begin(), nodeLngs.end());
+  this->minLat = *minLat;
+  this->minLng = *minLng;
+  latStep = std::max((*maxLat - *minLat) / sideLength, 1e-9);
+  lngStep = std::max((*maxLng - *minLng) / sideLength, 1e-9);
+  const double degreesToRadians = M_PI / 180;
+  lngScale = std::cos((*minLat + *maxLat) / 2 * degreesToRadians);
+
+  std::vector<size_t> cells(g.getNodeCount());
+  for (size_t i = 0; i < cells.size(); ++i) {
+    cells[i] = cellOf(nodeLats[i], this->minLat, latStep) * sideLength
+        + cellOf(nodeLngs[i], this->minLng, lngStep);
+    ++cellOffsets[cells[i] + 1];
+  }
+  std::partial_sum(cellOffsets.begin(), cellOffsets.end(), cellOffsets.begin());
+
+  nodes.resize(cells.size(), NodePos { 0 });
+  lats.resize(cells.size());
+  lngs.resize(cells.size());
+  auto next = cellOffsets;
+  for (size_t i = 0; i < cells.size(); ++i) {
+    auto index = next[cells[i]]++;
+    nodes[index] = NodePos { i };
+    lats[index] = nodeLats[i];
+    lngs[index] = nodeLngs[i];
+  }
+}
+
+std::pair<Lat, Lng> Grid::coordinatesOf(const Graph& g, NodePos pos)
+{
+  const auto& graph_properties = get_graph_properties();
+  size_t id = g.getNode(pos).id();
+  return { Lat { get<double>("lat", graph_properties, id) },
+    Lng { get<double>("lng", graph_properties, id) } };
+}
+
+long Grid::cellOf(double value, double min, double step) const
+{
+  return std::clamp(static_cast<long>((value - min) / step), 0L, sideLength - 1);
+}
+
+double Grid::distance(size_t index, double lat, double lng) const
+{
+  double dLat = lats[index] - lat;
+  double dLng = (lngs[index] - lng) * lngScale;
+  return std::sqrt(dLat * dLat + dLng * dLng);
+}
+
+std::optional<NodePos> Grid::findNearestNode(Lat lat, Lng lng) const
+{
+  auto nearest = findNearestNodes(lat, lng, 1);
+  if (nearest.empty()) {
+    return {};
+  }
+  return nearest.front();
+}
+
+std::vector<NodePos> Grid::findNearestNodes(Lat lat, Lng lng, size_t k) const
+{
+  if (nodes.empty() || k == 0) {
+    return {};
+  }
+  long row = cellOf(lat, minLat, latStep);
+  long column = cellOf(lng, minLng, lngStep);
+  // Every cell outside of ring r is at least r cells away from the position
+  double cellSize = std::min(latStep, lngStep * lngScale);
+
+  std::vector<std::pair<double, size_t>> found;
+  auto scanCell = [&](long r, long c) {
+    if (r < 0 || c < 0 || r >= sideLength || c >= sideLength) {
+      return;
+    }
+    size_t cell = r * sideLength + c;
+    for (size_t i = cellOffsets[cell]; i < cellOffsets[cell + 1]; ++i) {
+      found.emplace_back(distance(i, lat, lng), i);
+    }
+  };
+
+  for (long ring = 0; ring < sideLength; ++ring) {
+    if (ring == 0) {
+      scanCell(row, column);
+    } else {
+      for (long c = column - ring; c <= column + ring; ++c) {
+        scanCell(row - ring, c);
+        scanCell(row + ring, c);
+      }
+      for (long r = row - ring + 1; r < row + ring; ++r) {
+        scanCell(r, column - ring);
+        scanCell(r, column + ring);
+      }
+    }
+    if (found.size() >= k) {
+      std::nth_element(found.begin(), found.begin() + (k - 1), found.end());
+      found.resize(k);
+      if (found.back().first <= ring * cellSize) {
+        break;
+      }
+    }
+  }
+
+  std::sort(found.begin(), found.end());
+  if (found.size() > k) {
+    found.resize(k);
+  }
+  std::vector<NodePos> result;
+  for (const auto& [d, index] : found) {
+    result.push_back(nodes[index]);
+  }
+  return result;
+}
+
+} // namespace MULTI_CH_DIM_NAMESPACE
@@ -0,0 +1,64 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef GRID_H
+#define GRID_H
+
+#include "graph.hpp"
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+// Uniform grid over the node coordinates for snapping positions to nodes. The nodes are stored
+// in flat arrays sorted by cell, so a lookup scans the cells in rings around the position until
+// no unscanned cell can hold a nearer node.
+class Grid {
+  public:
+  // sideLength is the number of cells per side of the bounding box of the nodes
+  Grid(const Graph& g, long sideLength);
+  Grid(const Grid& other) = default;
+  Grid(Grid&& other) noexcept = default;
+  virtual ~Grid() noexcept = default;
+  Grid& operator=(const Grid& other) = default;
+  Grid& operator=(Grid&& other) noexcept = default;
+
+  std::optional<NodePos> findNearestNode(Lat lat, Lng lng) const;
+  // Up to k nodes, nearest first
+  std::vector<NodePos> findNearestNodes(Lat lat, Lng lng, size_t k) const;
+
+  // Throws if the node has no coordinates
+  static std::pair<Lat, Lng> coordinatesOf(const Graph& g, NodePos pos);
+
+  private:
+  long cellOf(double value, double min, double step) const;
+  // Distances use degrees with the longitude scaled to the middle latitude
+  double distance(size_t index, double lat, double lng) const;
+
+  long sideLength;
+  double minLat = 0;
+  double minLng = 0;
+  double latStep = 1;
+  double lngStep = 1;
+  double lngScale = 1;
+  std::vector<size_t> cellOffsets;
+  std::vector<NodePos> nodes;
+  std::vector<double> lats;
+  std::vector<double> lngs;
+};
+
+} // namespace MULTI_CH_DIM_NAMESPACE
+
+#endif /* GRID_H */
@@ -0,0 +1,100 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef HELPERTHREAD_H
+#define HELPERTHREAD_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// A thread which is started once and then runs one task at a time for its owner, so a task
+// only costs a wake up instead of creating and joining a thread. Copies and moves do not share
+// the thread, they start their own one on their first task.
+class HelperThread {
+  public:
+  HelperThread() = default;
+  HelperThread(const HelperThread& /*other*/) {}
+  HelperThread(HelperThread&& /*other*/) noexcept {}
+  virtual ~HelperThread() noexcept
+  {
+    {
+      std::lock_guard guard(key);
+      stop = true;
+    }
+    wakeUp.notify_one();
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+  HelperThread& operator=(const HelperThread& /*other*/) { return *this; }
+  HelperThread& operator=(HelperThread&& /*other*/) noexcept { return *this; }
+
+  // Runs the task on the helper thread, the previous task has to be waited for
+  void start(std::function<void()> task)
+  {
+    done.store(false, std::memory_order_relaxed);
+    {
+      std::lock_guard guard(key);
+      next = std::move(task);
+    }
+    if (!thread.joinable()) {
+      thread = std::thread { [this] { loop(); } };
+    }
+    wakeUp.notify_one();
+  }
+
+  // Returns when the last started task is finished. The task usually takes about as long as
+  // the work of the caller in between, so the caller spins instead of going to sleep.
+  void wait()
+  {
+    while (!done.load(std::memory_order_acquire)) {
+      std::this_thread::yield();
+    }
+  }
+
+  private:
+  void loop()
+  {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock guard(key);
+        wakeUp.wait(guard, [this] { return stop || next; });
+        if (stop) {
+          return;
+        }
+        task = std::move(next);
+        next = nullptr;
+      }
+      task();
+      done.store(true, std::memory_order_release);
+    }
+  }
+
+  std::mutex key {};
+  std::condition_variable wakeUp {};
+  std::function<void()> next {};
+  std::atomic<bool> done { true };
+  bool stop = false;
+  std::thread thread {};
+};
+
+#endif /* HELPERTHREAD_H */
@@ -0,0 +1,139 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef HUGEPAGES_H
+#define HUGEPAGES_H
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <unordered_map>
+#include <vector>
+
+// Allocates large arrays aligned to huge pages and asks the kernel to back them with
+// transparent huge pages. Randomly accessed arrays then need far fewer TLB entries. Small
+// arrays and all arrays while huge pages are disabled come from operator new.
+class HugePages {
+  public:
+  static constexpr size_t pageSize = 2 * 1024 * 1024;
+
+  static void enable(bool value) { enabled_ = value; }
+  static bool enabled() { return enabled_; }
+
+  static void* allocate(size_t bytes)
+  {
+    if (!enabled_ || bytes < pageSize) {
+      return ::operator new(bytes);
+    }
+    size_t size = (bytes + pageSize - 1) / pageSize * pageSize;
+    // Map one page more to be able to cut an aligned region out of it
+    auto* memory = static_cast<char*>(mmap(nullptr, size + pageSize, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (memory == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    auto offset = pageSize - reinterpret_cast<uintptr_t>(memory) % pageSize;
+    if (offset == pageSize) {
+      offset = 0;
+    }
+    if (offset > 0) {
+      munmap(memory, offset);
+    }
+    munmap(memory + offset + size, pageSize - offset);
+    char* aligned = memory + offset;
+    madvise(aligned, size, MADV_HUGEPAGE);
+
+    std::lock_guard guard(key);
+    mapped[aligned] = size;
+    ++mappedCount;
+    advised_ += size;
+    return aligned;
+  }
+
+  // Takes the size given to allocate. Small blocks and all blocks while no huge page mapping
+  // exists come from operator new, they are freed without taking the lock.
+  static void deallocate(void* memory, size_t bytes)
+  {
+    if (bytes >= pageSize && mappedCount > 0) {
+      std::lock_guard guard(key);
+      auto it = mapped.find(memory);
+      if (it != mapped.end()) {
+        munmap(it->first, it->second);
+        advised_ -= it->second;
+        mapped.erase(it);
+        --mappedCount;
+        return;
+      }
+    }
+    ::operator delete(memory);
+  }
+
+  // Bytes currently allocated with the huge page advice
+  static size_t advised()
+  {
+    std::lock_guard guard(key);
+    return advised_;
+  }
+
+  // Bytes of the process which are backed by transparent huge pages
+  static size_t backed()
+  {
+    std::ifstream smaps { "/proc/self/smaps_rollup" };
+    std::string name;
+    size_t kiloBytes = 0;
+    while (smaps >> name) {
+      if (name == "AnonHugePages:") {
+        smaps >> kiloBytes;
+        return kiloBytes * 1024;
+      }
+      smaps.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    return 0;
+  }
+
+  private:
+  static inline std::atomic<bool> enabled_ { false };
+  static inline std::atomic<size_t> mappedCount { 0 };
+  static inline std::mutex key {};
+  static inline size_t advised_ = 0;
+  static inline std::unordered_map<void*, size_t> mapped {};
+};
+
+template <class T> class HugePageAllocator {
+  public:
+  using value_type = T;
+  using is_always_equal = std::true_type;
+
+  HugePageAllocator() = default;
+  template <class U> HugePageAllocator(const HugePageAllocator<U>& /*other*/) {}
+
+  T* allocate(size_t n) { return static_cast<T*>(HugePages::allocate(n * sizeof(T))); }
+  void deallocate(T* p, size_t n) { HugePages::deallocate(p, n * sizeof(T)); }
+
+  template <class U> bool operator==(const HugePageAllocator<U>& /*other*/) const { return true; }
+  template <class U> bool operator!=(const HugePageAllocator<U>& /*other*/) const { return false; }
+};
+
+// Vector which is backed by huge pages if they are enabled
+template <class T> using HugeVector = std::vector<T, HugePageAllocator<T>>;
+
+#endif /* HUGEPAGES_H */
@@ -0,0 +1,158 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef LPCORPUS_H
+#define LPCORPUS_H
+
+#include "graph.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <unistd.h>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+struct LpProblem {
+  std::vector<std::array<double, Cost::dim>> constraints;
+  bool feasible = false;
+  std::vector<double> values;
+  double delta = -1;
+};
+
+// Records a sample of the LPs solved while contracting to a binary corpus for bench_lp. The file
+// starts with a magic and the dimension, followed by one record per problem: the constraint count
+// (uint32), the feasibility (uint8), the constraints and for feasible problems the values and
+// delta. Every record is appended with a single write, so forked partition workers can share
+// the file.
+class LpCorpus {
+  public:
+  static void record(const std::string& fileName, double sampleRate)
+  {
+    std::lock_guard guard(key);
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+    rate = sampleRate;
+    if (fileName.empty()) {
+      return;
+    }
+    fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Could not open " + fileName + ": " + std::strerror(errno));
+    }
+    std::string header { magic, sizeof(magic) };
+    append(header, static_cast<uint64_t>(Cost::dim));
+    writeRecord(header);
+  }
+
+  static bool recording() { return fd >= 0; }
+
+  // Decides if the next problem is part of the sample
+  static bool sample()
+  {
+    // Forked partition workers inherit the generator of their parent, so every process seeds
+    // its own
+    thread_local pid_t seeded = 0;
+    thread_local std::mt19937 random {};
+    if (seeded != getpid()) {
+      seeded = getpid();
+      random.seed(std::random_device {}() ^ static_cast<std::mt19937::result_type>(seeded));
+    }
+    return std::uniform_real_distribution<double>(0, 1)(random) < rate;
+  }
+
+  static void add(const LpProblem& problem)
+  {
+    std::string record;
+    append(record, static_cast<uint32_t>(problem.constraints.size()));
+    append(record, static_cast<uint8_t>(problem.feasible));
+    for (const auto& constraint : problem.constraints) {
+      for (auto value : constraint) {
+        append(record, value);
+      }
+    }
+    if (problem.feasible) {
+      for (size_t i = 0; i < Cost::dim; ++i) {
+        append(record, problem.values[i]);
+      }
+      append(record, problem.delta);
+    }
+    std::lock_guard guard(key);
+    writeRecord(record);
+  }
+
+  static std::vector<LpProblem> read(const std::string& fileName)
+  {
+    std::ifstream in { fileName, std::ios::binary };
+    char fileMagic[sizeof(magic)];
+    uint64_t dim = 0;
+    in.read(fileMagic, sizeof(fileMagic));
+    in.read(reinterpret_cast<char*>(&dim), sizeof(dim));
+    if (!in || std::memcmp(fileMagic, magic, sizeof(magic)) != 0 || dim != Cost::dim) {
+      throw std::invalid_argument(
+          fileName + " is not an LP corpus of dimension " + std::to_string(Cost::dim));
+    }
+    std::vector<LpProblem> problems;
+    uint32_t count = 0;
+    while (in.read(reinterpret_cast<char*>(&count), sizeof(count))) {
+      LpProblem problem;
+      uint8_t feasible = 0;
+      in.read(reinterpret_cast<char*>(&feasible), sizeof(feasible));
+      problem.feasible = feasible != 0;
+      problem.constraints.resize(count);
+      in.read(reinterpret_cast<char*>(problem.constraints.data()),
+          static_cast<std::streamsize>(count * sizeof(std::array<double, Cost::dim>)));
+      if (problem.feasible) {
+        problem.values.resize(Cost::dim);
+        in.read(reinterpret_cast<char*>(problem.values.data()),
+            static_cast<std::streamsize>(Cost::dim * sizeof(double)));
+        in.read(reinterpret_cast<char*>(&problem.delta), sizeof(problem.delta));
+      }
+      if (!in) {
+        throw std::invalid_argument(fileName + " ends in the middle of a problem");
+      }
+      problems.push_back(std::move(problem));
+    }
+    return problems;
+  }
+
+  private:
+  template <class T> static void append(std::string& buffer, T value)
+  {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  static void writeRecord(const std::string& record)
+  {
+    if (fd >= 0 && write(fd, record.data(), record.size()) != static_cast<ssize_t>(record.size())) {
+      std::cerr << "Could not write LP corpus: " << std::strerror(errno) << '\n';
+    }
+  }
+
+  static constexpr char magic[8] = "MCHLP01";
+  static inline std::mutex key {};
+  static inline int fd = -1;
+  static inline double rate = 0;
+};
+
+} // namespace MULTI_CH_DIM_NAMESPACE
+
+#endif /* LPCORPUS_H */
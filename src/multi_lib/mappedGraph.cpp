@@ -0,0 +1,395 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "mappedGraph.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+namespace {
+const double unreached = std::numeric_limits<double>::max();
+
+// Whether count elements of T at offset lie inside of a mapping of size bytes
+template <class T> bool fits(uint64_t offset, uint64_t count, size_t size)
+{
+  return offset % alignof(T) == 0 && offset <= size && count <= (size - offset) / sizeof(T);
+}
+
+// Whether index is -1 or refers to one of count elements
+bool validIndex(int64_t index, uint64_t count)
+{
+  return index == -1 || (index >= 0 && static_cast<uint64_t>(index) < count);
+}
+
+template <class T> void writeArray(std::ofstream& out, const std::vector<T>& values)
+{
+  out.write(reinterpret_cast<const char*>(values.data()),
+      static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+}
+
+void MappedGraph::write(const Graph& g, const std::string& fileName)
+{
+  std::vector<uint64_t> levels;
+  std::vector<uint64_t> nodeIds;
+  std::vector<uint64_t> outOffsets { 0 };
+  std::vector<uint64_t> inOffsets { 0 };
+  std::vector<FlatHalfEdge> outEdges;
+  std::vector<FlatHalfEdge> inEdges;
+  auto flatten = [](const HalfEdge& e) {
+    FlatHalfEdge flat { e.end, e.id, {} };
+    std::copy(e.cost.values.begin(), e.cost.values.end(), flat.cost);
+    return flat;
+  };
+  for (size_t i = 0; i < g.getNodeCount(); ++i) {
+    NodePos pos { i };
+    levels.push_back(g.getLevelOf(pos));
+    nodeIds.push_back(g.getNode(pos).id());
+    for (const auto& e : g.getOutgoingEdgesOf(pos)) {
+      outEdges.push_back(flatten(e));
+    }
+    outOffsets.push_back(outEdges.size());
+    for (const auto& e : g.getIngoingEdgesOf(pos)) {
+      inEdges.push_back(flatten(e));
+    }
+    inOffsets.push_back(inEdges.size());
+  }
+
+  std::vector<FlatEdge> edges;
+  std::vector<FlatRegion> regions;
+  edges.reserve(Edge::edges.size());
+  for (size_t i = 0; i < Edge::edges.size(); ++i) {
+    const auto& e = Edge::getEdge(EdgeId { i });
+    FlatEdge flat { e.getSourceId(), e.getDestId(), -1, -1, {}, -1 };
+    if (e.valid() && e.getEdgeA()) {
+      flat.edgeA = static_cast<int64_t>(e.getEdgeA()->get());
+      flat.edgeB = static_cast<int64_t>(e.getEdgeB()->get());
+    }
+    if (const auto* region = Edge::getConfigRegion(EdgeId { i })) {
+      FlatRegion flatRegion { region->count, {} };
+      for (size_t j = 0; j < region->count; ++j) {
+        const auto& values = region->halfSpaces[j].values;
+        std::copy(values.begin(), values.end(), flatRegion.halfSpaces[j]);
+      }
+      flat.region = static_cast<int64_t>(regions.size());
+      regions.push_back(flatRegion);
+    }
+    std::copy(e.getCost().values.begin(), e.getCost().values.end(), flat.cost);
+    edges.push_back(flat);
+  }
+
+  Header header {};
+  std::copy(std::begin(magic), std::end(magic), header.magic);
+  header.dim = Cost::dim;
+  header.nodeCount = levels.size();
+  header.outEdgeCount = outEdges.size();
+  header.inEdgeCount = inEdges.size();
+  header.edgeCount = edges.size();
+  header.regionCount = regions.size();
+  header.levels = sizeof(Header);
+  header.nodeIds = header.levels + levels.size() * sizeof(uint64_t);
+  header.outOffsets = header.nodeIds + nodeIds.size() * sizeof(uint64_t);
+  header.inOffsets = header.outOffsets + outOffsets.size() * sizeof(uint64_t);
+  header.outEdges = header.inOffsets + inOffsets.size() * sizeof(uint64_t);
+  header.inEdges = header.outEdges + outEdges.size() * sizeof(FlatHalfEdge);
+  header.edges = header.inEdges + inEdges.size() * sizeof(FlatHalfEdge);
+  header.regions = header.edges + edges.size() * sizeof(FlatEdge);
+
+  std::ofstream out { fileName, std::ios::binary | std::ios::trunc };
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  writeArray(out, levels);
+  writeArray(out, nodeIds);
+  writeArray(out, outOffsets);
+  writeArray(out, inOffsets);
+  writeArray(out, outEdges);
+  writeArray(out, inEdges);
+  writeArray(out, edges);
+  writeArray(out, regions);
+  if (!out) {
+    throw std::runtime_error("Could not write query file " + fileName);
+  }
+}
+
+MappedGraph::MappedGraph(const std::string& fileName)
+{
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Could not open " + fileName + ": " + std::strerror(errno));
+  }
+  struct stat status {};
+  if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(Header)) {
+    close(fd);
+    throw std::invalid_argument(fileName + " is not a query file");
+  }
+  size = static_cast<size_t>(status.st_size);
+  memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) {
+    throw std::runtime_error("Could not map " + fileName + ": " + std::strerror(errno));
+  }
+
+  header = static_cast<const Header*>(memory);
+  if (std::memcmp(header->magic, magic, sizeof(magic)) != 0 || header->dim != Cost::dim) {
+    munmap(memory, size);
+    throw std::invalid_argument(
+        fileName + " is not a query file of dimension " + std::to_string(Cost::dim));
+  }
+  // The node count is checked first, so adding one to it cannot overflow
+  const auto& h = *header;
+  if (!fits<uint64_t>(h.levels, h.nodeCount, size)
+      || !fits<uint64_t>(h.nodeIds, h.nodeCount, size)
+      || !fits<uint64_t>(h.outOffsets, h.nodeCount + 1, size)
+      || !fits<uint64_t>(h.inOffsets, h.nodeCount + 1, size)
+      || !fits<FlatHalfEdge>(h.outEdges, h.outEdgeCount, size)
+      || !fits<FlatHalfEdge>(h.inEdges, h.inEdgeCount, size)
+      || !fits<FlatEdge>(h.edges, h.edgeCount, size)
+      || !fits<FlatRegion>(h.regions, h.regionCount, size)) {
+    munmap(memory, size);
+    throw std::invalid_argument(fileName + " is truncated");
+  }
+  auto at = [this](uint64_t offset) { return static_cast<const char*>(memory) + offset; };
+  levels = reinterpret_cast<const uint64_t*>(at(header->levels));
+  nodeIds = reinterpret_cast<const uint64_t*>(at(header->nodeIds));
+  outOffsets = reinterpret_cast<const uint64_t*>(at(header->outOffsets));
+  inOffsets = reinterpret_cast<const uint64_t*>(at(header->inOffsets));
+  outEdges = reinterpret_cast<const FlatHalfEdge*>(at(header->outEdges));
+  inEdges = reinterpret_cast<const FlatHalfEdge*>(at(header->inEdges));
+  edges = reinterpret_cast<const FlatEdge*>(at(header->edges));
+  regions = reinterpret_cast<const FlatRegion*>(at(header->regions));
+  if (!indicesValid()) {
+    munmap(memory, size);
+    throw std::invalid_argument(fileName + " contains offsets or indices out of range");
+  }
+}
+
+// Reads every offset and index once, so queries never leave the arrays of a corrupt file
+bool MappedGraph::indicesValid() const
+{
+  auto nodeCount = header->nodeCount;
+  auto edgeCount = header->edgeCount;
+  auto validOffsets = [nodeCount](const uint64_t* offsets, uint64_t halfEdgeCount) {
+    return offsets[0] == 0 && offsets[nodeCount] <= halfEdgeCount
+        && std::is_sorted(offsets, offsets + nodeCount + 1);
+  };
+  auto validHalfEdge = [nodeCount, edgeCount](const FlatHalfEdge& e) {
+    return e.end < nodeCount && e.edge < edgeCount;
+  };
+  auto validEdge = [this, edgeCount](const FlatEdge& e) {
+    return validIndex(e.edgeA, edgeCount) && validIndex(e.edgeB, edgeCount)
+        && (e.edgeA < 0) == (e.edgeB < 0) && validIndex(e.region, header->regionCount);
+  };
+  auto validRegion
+      = [](const FlatRegion& region) { return region.count <= ConfigRegion::maxHalfSpaces; };
+  return validOffsets(outOffsets, header->outEdgeCount)
+      && validOffsets(inOffsets, header->inEdgeCount)
+      && std::all_of(outEdges, outEdges + header->outEdgeCount, validHalfEdge)
+      && std::all_of(inEdges, inEdges + header->inEdgeCount, validHalfEdge)
+      && std::all_of(edges, edges + edgeCount, validEdge)
+      && std::all_of(regions, regions + header->regionCount, validRegion);
+}
+
+MappedGraph::~MappedGraph() noexcept { munmap(memory, size); }
+
+MappedDijkstra::MappedDijkstra(const MappedGraph& g)
+    : g(g)
+    , costS(g.getNodeCount(), unreached)
+    , costT(g.getNodeCount(), unreached)
+    , previousS(g.getNodeCount())
+    , previousT(g.getNodeCount())
+{
+}
+
+double MappedDijkstra::costOf(const MappedGraph::FlatHalfEdge& edge) const
+{
+  double cost = 0;
+  for (size_t i = 0; i < Cost::dim; ++i) {
+    cost += edge.cost[i] * config.values[i];
+  }
+  return cost;
+}
+
+bool MappedDijkstra::inConfigRegion(const MappedGraph::FlatHalfEdge& edge) const
+{
+  auto index = g.getEdge(edge.edge).region;
+  if (index < 0) {
+    return true;
+  }
+  const auto& region = g.getRegion(static_cast<size_t>(index));
+  for (size_t i = 0; i < region.count; ++i) {
+    double value = 0;
+    for (size_t j = 0; j < Cost::dim; ++j) {
+      value += region.halfSpaces[i][j] * config.values[j];
+    }
+    if (value < -COST_ACCURACY) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool MappedDijkstra::stallOnDemand(NodePos node, double cost, Direction dir) const
+{
+  auto myLevel = g.getLevelOf(node);
+  const auto& costs = dir == Direction::S ? costS : costT;
+  auto begin = dir == Direction::S ? g.inBegin(node) : g.outBegin(node);
+  auto end = dir == Direction::S ? g.inEnd(node) : g.outEnd(node);
+  for (auto edge = begin; edge != end; ++edge) {
+    NodePos next { edge->end };
+    if (g.getLevelOf(next) < myLevel) {
+      return false;
+    }
+    if (costs[next] != unreached && costs[next] + costOf(*edge) < cost) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void MappedDijkstra::relaxEdges(NodePos node, double cost, Direction dir, Queue& heap)
+{
+  auto myLevel = g.getLevelOf(node);
+  auto& costs = dir == Direction::S ? costS : costT;
+  auto& previous = dir == Direction::S ? previousS : previousT;
+  auto& touched = dir == Direction::S ? touchedS : touchedT;
+  auto begin = dir == Direction::S ? g.outBegin(node) : g.inBegin(node);
+  auto end = dir == Direction::S ? g.outEnd(node) : g.inEnd(node);
+  for (auto edge = begin; edge != end; ++edge) {
+    NodePos next { edge->end };
+    if (g.getLevelOf(next) < myLevel) {
+      break;
+    }
+    if (useConfigRegions && !inConfigRegion(*edge)) {
+      continue;
+    }
+    double nextCost = cost + costOf(*edge);
+    if (nextCost < costs[next]) {
+      costs[next] = nextCost;
+      previous[next] = { node, edge };
+      touched.push_back(next);
+      heap.emplace(nextCost, next);
+    }
+  }
+}
+
+void MappedDijkstra::unpack(size_t edge, std::vector<size_t>& route) const
+{
+  const auto& e = g.getEdge(edge);
+  if (e.edgeA < 0) {
+    route.push_back(edge);
+    return;
+  }
+  unpack(static_cast<size_t>(e.edgeA), route);
+  unpack(static_cast<size_t>(e.edgeB), route);
+}
+
+void MappedDijkstra::pruneByConfigRegion(bool value)
+{
+  useConfigRegions = value && g.getRegionCount() > 0;
+}
+
+std::optional<MappedRoute> MappedDijkstra::findBestRoute(
+    NodePos from, NodePos to, const Config& config)
+{
+  for (auto node : touchedS) {
+    costS[node] = unreached;
+  }
+  touchedS.clear();
+  for (auto node : touchedT) {
+    costT[node] = unreached;
+  }
+  touchedT.clear();
+  this->config = config;
+
+  Queue heapS;
+  heapS.emplace(0, from);
+  costS[from] = 0;
+  touchedS.push_back(from);
+  Queue heapT;
+  heapT.emplace(0, to);
+  costT[to] = 0;
+  touchedT.push_back(to);
+
+  double best = unreached;
+  std::optional<NodePos> meeting = {};
+  bool sDone = false;
+  bool tDone = false;
+  auto step = [&](Direction dir, Queue& heap, bool& done) {
+    const auto& costs = dir == Direction::S ? costS : costT;
+    const auto& otherCosts = dir == Direction::S ? costT : costS;
+    if (heap.empty()) {
+      done = true;
+      return;
+    }
+    auto [cost, node] = heap.top();
+    heap.pop();
+    if (cost > costs[node]) {
+      return;
+    }
+    if (cost > best) {
+      done = true;
+      return;
+    }
+    if (stallOnDemand(node, cost, dir)) {
+      return;
+    }
+    if (otherCosts[node] != unreached && cost + otherCosts[node] < best) {
+      best = cost + otherCosts[node];
+      meeting = node;
+    }
+    relaxEdges(node, cost, dir, heap);
+  };
+  while (!sDone || !tDone) {
+    if (!sDone) {
+      step(Direction::S, heapS, sDone);
+    }
+    if (!tDone) {
+      step(Direction::T, heapT, tDone);
+    }
+  }
+  if (!meeting) {
+    return {};
+  }
+
+  MappedRoute route {};
+  std::vector<size_t> upward;
+  for (NodePos node = *meeting; node != from; node = previousS[node].node) {
+    upward.push_back(previousS[node].edge->edge);
+    route.costs = route.costs + Cost { std::vector(previousS[node].edge->cost,
+                                    previousS[node].edge->cost + Cost::dim) };
+  }
+  for (auto edge = upward.rbegin(); edge != upward.rend(); ++edge) {
+    unpack(*edge, route.edges);
+  }
+  for (NodePos node = *meeting; node != to; node = previousT[node].node) {
+    unpack(previousT[node].edge->edge, route.edges);
+    route.costs = route.costs + Cost { std::vector(previousT[node].edge->cost,
+                                    previousT[node].edge->cost + Cost::dim) };
+  }
+  return route;
+}
+
+} // namespace MULTI_CH_DIM_NAMESPACE
@@ -0,0 +1,160 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef MAPPEDGRAPH_H
+#define MAPPEDGRAPH_H
+
+#include "dijkstra.hpp"
+#include <cstdint>
+#include <functional>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+// Query ready layout of a contracted graph in a single file without pointers. Query processes
+// map the file read only, so all of them share one copy in the page cache and start without
+// parsing or rebuilding the graph. All arrays are indexed by node position or edge id.
+class MappedGraph {
+  public:
+  struct FlatHalfEdge {
+    uint64_t end;
+    uint64_t edge;
+    double cost[Cost::dim];
+  };
+  struct FlatEdge {
+    uint64_t source;
+    uint64_t dest;
+    // Replaced edges of a shortcut, -1 for original edges
+    int64_t edgeA;
+    int64_t edgeB;
+    double cost[Cost::dim];
+    // Index of the config region of a shortcut, -1 if the edge is needed for every config
+    int64_t region;
+  };
+  // Flat copy of a ConfigRegion
+  struct FlatRegion {
+    uint64_t count;
+    double halfSpaces[ConfigRegion::maxHalfSpaces][Cost::dim];
+  };
+
+  explicit MappedGraph(const std::string& fileName);
+  MappedGraph(const MappedGraph& other) = delete;
+  MappedGraph(MappedGraph&& other) = delete;
+  virtual ~MappedGraph() noexcept;
+  MappedGraph& operator=(const MappedGraph& other) = delete;
+  MappedGraph& operator=(MappedGraph&& other) = delete;
+
+  static void write(const Graph& g, const std::string& fileName);
+
+  size_t getNodeCount() const { return header->nodeCount; }
+  size_t getLevelOf(NodePos pos) const { return levels[pos]; }
+  NodeId getNodeId(NodePos pos) const { return NodeId { nodeIds[pos] }; }
+  const FlatHalfEdge* outBegin(NodePos pos) const { return outEdges + outOffsets[pos]; }
+  const FlatHalfEdge* outEnd(NodePos pos) const { return outEdges + outOffsets[pos + 1]; }
+  const FlatHalfEdge* inBegin(NodePos pos) const { return inEdges + inOffsets[pos]; }
+  const FlatHalfEdge* inEnd(NodePos pos) const { return inEdges + inOffsets[pos + 1]; }
+  const FlatEdge& getEdge(size_t id) const { return edges[id]; }
+  size_t getRegionCount() const { return header->regionCount; }
+  const FlatRegion& getRegion(size_t index) const { return regions[index]; }
+
+  // Query files start with this magic followed by the dimension as uint64_t
+  static constexpr char magic[8] = "MCHQRY2";
+
+  private:
+  struct Header {
+    char magic[8];
+    uint64_t dim;
+    uint64_t nodeCount;
+    uint64_t outEdgeCount;
+    uint64_t inEdgeCount;
+    uint64_t edgeCount;
+    uint64_t regionCount;
+    // Byte offsets of the arrays in the file
+    uint64_t levels;
+    uint64_t nodeIds;
+    uint64_t outOffsets;
+    uint64_t inOffsets;
+    uint64_t outEdges;
+    uint64_t inEdges;
+    uint64_t edges;
+    uint64_t regions;
+  };
+
+  bool indicesValid() const;
+
+  void* memory = nullptr;
+  size_t size = 0;
+  const Header* header = nullptr;
+  const uint64_t* levels = nullptr;
+  const uint64_t* nodeIds = nullptr;
+  const uint64_t* outOffsets = nullptr;
+  const uint64_t* inOffsets = nullptr;
+  const FlatHalfEdge* outEdges = nullptr;
+  const FlatHalfEdge* inEdges = nullptr;
+  const FlatEdge* edges = nullptr;
+  const FlatRegion* regions = nullptr;
+};
+
+struct MappedRoute {
+  Cost costs;
+  // Ids of the original edges in route order
+  std::vector<size_t> edges;
+};
+
+// Bidirectional CH query with stall on demand which works directly on a MappedGraph
+class MappedDijkstra {
+  public:
+  explicit MappedDijkstra(const MappedGraph& g);
+  MappedDijkstra(const MappedDijkstra& other) = default;
+  MappedDijkstra(MappedDijkstra&& other) noexcept = default;
+  virtual ~MappedDijkstra() noexcept = default;
+  MappedDijkstra& operator=(const MappedDijkstra& other) = delete;
+  MappedDijkstra& operator=(MappedDijkstra&& other) noexcept = delete;
+
+  std::optional<MappedRoute> findBestRoute(NodePos from, NodePos to, const Config& config);
+  // Skips shortcuts whose config region does not contain the config of the query
+  void pruneByConfigRegion(bool value);
+
+  private:
+  enum class Direction { S, T };
+  using QueueElem = std::pair<double, NodePos>;
+  using Queue = std::priority_queue<QueueElem, std::vector<QueueElem>, std::greater<>>;
+
+  double costOf(const MappedGraph::FlatHalfEdge& edge) const;
+  bool inConfigRegion(const MappedGraph::FlatHalfEdge& edge) const;
+  bool stallOnDemand(NodePos node, double cost, Direction dir) const;
+  void relaxEdges(NodePos node, double cost, Direction dir, Queue& heap);
+  void unpack(size_t edge, std::vector<size_t>& route) const;
+
+  const MappedGraph& g;
+  Config config = Config(std::vector(Cost::dim, 0.0));
+  bool useConfigRegions = false;
+  std::vector<double> costS;
+  std::vector<double> costT;
+  // Node and half edge a node was reached by
+  struct Previous {
+    NodePos node { 0 };
+    const MappedGraph::FlatHalfEdge* edge = nullptr;
+  };
+  std::vector<Previous> previousS;
+  std::vector<Previous> previousT;
+  std::vector<NodePos> touchedS;
+  std::vector<NodePos> touchedT;
+};
+
+} // namespace MULTI_CH_DIM_NAMESPACE
+
+#endif /* MAPPEDGRAPH_H */
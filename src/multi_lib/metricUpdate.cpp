@@ -0,0 +1,493 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "metricUpdate.hpp"
+#include "contractionLP.hpp"
+#include "contractor.hpp"
+#include <cmath>
+#include <fstream>
+#include <future>
+#include <map>
+#include <sstream>
+#include <unordered_set>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+namespace {
+// Splits the indices into one consecutive block per thread
+template <class F> void forEachParallel(size_t count, size_t threadCount, F f)
+{
+  const size_t blockSize = std::max<size_t>(256, (count + threadCount - 1) / threadCount);
+  std::vector<std::future<void>> futures;
+  for (size_t begin = blockSize; begin < count; begin += blockSize) {
+    futures.push_back(std::async(std::launch::async, [&f, begin, count, blockSize] {
+      for (size_t i = begin; i < std::min(count, begin + blockSize); ++i) {
+        f(i);
+      }
+    }));
+  }
+  for (size_t i = 0; i < std::min(count, blockSize); ++i) {
+    f(i);
+  }
+  for (auto& future : futures) {
+    future.get();
+  }
+}
+
+enum class Change : char { none, decrease, increase };
+
+// A cost higher in some dimension may invalidate witnesses, a lower one only changes shortcuts.
+// Graph files keep seven digits, so costs are compared relative to their size.
+Change compare(const Cost& before, const Cost& after)
+{
+  auto change = Change::none;
+  for (size_t i = 0; i < Cost::dim; ++i) {
+    double tolerance = COST_ACCURACY * std::max(1.0, std::abs(before.values[i]));
+    if (after.values[i] > before.values[i] + tolerance) {
+      return Change::increase;
+    }
+    if (after.values[i] < before.values[i] - tolerance) {
+      change = Change::decrease;
+    }
+  }
+  return change;
+}
+
+// The edges of the graph at a node followed by the added ones
+std::vector<HalfEdge> withAdded(const EdgeRange& edges, const AddedEdges& added, NodePos node)
+{
+  std::vector<HalfEdge> result(edges.begin(), edges.end());
+  auto extra = added.find(node);
+  if (extra != added.end()) {
+    result.insert(result.end(), extra->second.begin(), extra->second.end());
+  }
+  return result;
+}
+}
+
+MetricUpdate::MetricUpdate(Graph& g, size_t threadCount)
+    : g(g)
+    , threadCount(std::max<size_t>(1, threadCount))
+    , parents(Edge::edges.size())
+{
+  while (lps.size() < this->threadCount) {
+    lps.push_back(std::make_unique<ContractionLp>());
+    dijkstras.push_back(g.createNormalDijkstra());
+    dijkstras.back().setAddedEdges(&addedOut);
+  }
+  for (const auto& e : Edge::edges) {
+    if (e.getEdgeA()) {
+      addParents(e.getId());
+    }
+  }
+  for (size_t i = 0; i < g.getNodeCount(); ++i) {
+    coreLevel = std::max(coreLevel, g.getLevelOf(NodePos { i }));
+  }
+}
+
+MetricUpdate::~MetricUpdate() noexcept = default;
+
+void MetricUpdate::addParents(EdgeId shortcut)
+{
+  if (parents.size() < Edge::edges.size()) {
+    parents.resize(Edge::edges.size());
+  }
+  const auto& e = Edge::getEdge(shortcut);
+  parents[*e.getEdgeA()].push_back(shortcut);
+  parents[*e.getEdgeB()].push_back(shortcut);
+}
+
+bool MetricUpdate::hasShortcut(EdgeId in, EdgeId out) const
+{
+  return std::any_of(parents[in].begin(), parents[in].end(),
+      [&out](const EdgeId& id) { return Edge::getEdge(id).getEdgeB() == out; });
+}
+
+// The nodes of a level were not adjacent when they were contracted. Added shortcuts can connect
+// two of them, then the one at the lower position counts as contracted first.
+bool MetricUpdate::contractedBefore(NodePos node, NodePos other) const
+{
+  auto level = g.getLevelOf(node);
+  auto otherLevel = g.getLevelOf(other);
+  return level < otherLevel || (level == otherLevel && node < other);
+}
+
+void MetricUpdate::update(const std::vector<CostChange>& changes)
+{
+  updatedShortcutCount = 0;
+  checkedNodeCount = 0;
+  checkedPairCount = 0;
+  addedShortcutCount = 0;
+
+  changedEdges.clear();
+  recheckedPairs.clear();
+  std::unordered_set<EdgeId> increased;
+  std::vector<EdgeId> changed;
+  for (const auto& change : changes) {
+    if (change.edge >= Edge::edges.size()) {
+      throw std::invalid_argument("Edge " + std::to_string(change.edge.get()) + " does not exist");
+    }
+    auto& e = Edge::getMutEdge(change.edge);
+    if (e.getEdgeA()) {
+      throw std::invalid_argument("Edge " + std::to_string(change.edge.get())
+          + " is a shortcut, only base edges can change");
+    }
+    auto kind = compare(e.getCost(), change.cost);
+    if (kind == Change::increase) {
+      increased.insert(change.edge);
+    }
+    e.setCost(change.cost);
+    if (kind != Change::none) {
+      changed.push_back(change.edge);
+    }
+  }
+
+  // The parts of a shortcut are contained in shortcuts of lower levels only, so each level only
+  // reads costs which are already updated
+  auto levelOf = [this](EdgeId shortcut) {
+    return g.getLevelOf(Edge::getEdge(*Edge::getEdge(shortcut).getEdgeA()).destPos());
+  };
+  std::map<size_t, std::vector<EdgeId>> shortcutsByLevel;
+  std::unordered_set<EdgeId> affected;
+  std::vector<EdgeId> stack { changed };
+  while (!stack.empty()) {
+    auto id = stack.back();
+    stack.pop_back();
+    for (const auto& parent : parents[id]) {
+      if (affected.insert(parent).second) {
+        shortcutsByLevel[levelOf(parent)].push_back(parent);
+        stack.push_back(parent);
+      }
+    }
+  }
+  std::vector<Change> kinds;
+  std::vector<EdgeId> updated { changed };
+  for (const auto& [level, shortcuts] : shortcutsByLevel) {
+    kinds.assign(shortcuts.size(), Change::none);
+    forEachParallel(shortcuts.size(), threadCount, [&shortcuts, &kinds](size_t i) {
+      auto& s = Edge::getMutEdge(shortcuts[i]);
+      auto cost = Edge::getEdge(*s.getEdgeA()).getCost() + Edge::getEdge(*s.getEdgeB()).getCost();
+      kinds[i] = compare(s.getCost(), cost);
+      s.setCost(cost);
+      // The witnesses bounding the region were found with the old costs
+      Edge::clearConfigRegion(shortcuts[i]);
+    });
+    for (size_t i = 0; i < shortcuts.size(); ++i) {
+      if (kinds[i] != Change::none) {
+        changed.push_back(shortcuts[i]);
+      }
+      if (kinds[i] == Change::increase) {
+        increased.insert(shortcuts[i]);
+      }
+    }
+    updatedShortcutCount += shortcuts.size();
+    updated.insert(updated.end(), shortcuts.begin(), shortcuts.end());
+  }
+  g.refreshEdges(updated);
+  changedEdges.insert(changed.begin(), changed.end());
+
+  std::map<size_t, std::set<NodePos>> pendingNodes;
+  auto touch = [this, &pendingNodes](NodePos node) {
+    auto level = g.getLevelOf(node);
+    if (level < coreLevel) {
+      pendingNodes[level].insert(node);
+    }
+  };
+  for (const auto& id : changed) {
+    touch(Edge::getEdge(id).sourcePos());
+    touch(Edge::getEdge(id).destPos());
+  }
+  checkAllPairs = !increased.empty() && !witnessesKnown;
+  if (checkAllPairs) {
+    for (size_t i = 0; i < g.getNodeCount(); ++i) {
+      touch(NodePos { i });
+    }
+  } else if (!increased.empty()) {
+    for (const auto& [pair, used] : witnessEdges) {
+      if (used.empty()
+          || std::any_of(used.begin(), used.end(),
+              [&increased](const EdgeId& id) { return increased.count(id) > 0; })) {
+        recheckedPairs.insert(pair);
+        // The node of the pair is the source of its out edge
+        touch(Edge::getEdge(pair.second).sourcePos());
+      }
+    }
+  }
+
+  // A new shortcut is part of the pairs at its end nodes, which are on higher levels
+  std::vector<EdgeId> added;
+  while (!pendingNodes.empty()) {
+    std::vector<NodePos> nodes { pendingNodes.begin()->second.begin(),
+      pendingNodes.begin()->second.end() };
+    pendingNodes.erase(pendingNodes.begin());
+    checkedNodeCount += nodes.size();
+    auto shortcuts = checkLevel(nodes);
+    if (shortcuts.empty()) {
+      continue;
+    }
+    addedShortcutCount += shortcuts.size();
+    auto ids = Edge::administerEdges(std::move(shortcuts));
+    for (const auto& id : ids) {
+      addParents(id);
+      changedEdges.insert(id);
+      const auto& e = Edge::getEdge(id);
+      addedOut[e.sourcePos()].push_back(e.makeHalfEdge(e.sourcePos(), e.destPos()));
+      addedIn[e.destPos()].push_back(e.makeHalfEdge(e.destPos(), e.sourcePos()));
+      touch(e.sourcePos());
+      touch(e.destPos());
+    }
+    added.insert(added.end(), ids.begin(), ids.end());
+  }
+  addedOut.clear();
+  addedIn.clear();
+  if (!added.empty()) {
+    rebuildGraph(added);
+  }
+  witnessesKnown |= checkAllPairs;
+}
+
+std::vector<Edge> MetricUpdate::checkLevel(const std::vector<NodePos>& nodes)
+{
+  std::atomic<size_t> next = 0;
+  std::atomic<size_t> pairs = 0;
+  std::vector<std::future<std::vector<Edge>>> futures;
+  for (size_t i = 1; i < std::min(threadCount, nodes.size()); ++i) {
+    futures.push_back(std::async(std::launch::async, [this, &nodes, &next, &pairs, i] {
+      return checkNodes(nodes, next, dijkstras[i], *lps[i], pairs);
+    }));
+  }
+  auto shortcuts = checkNodes(nodes, next, dijkstras[0], *lps[0], pairs);
+  for (auto& future : futures) {
+    auto found = future.get();
+    std::move(found.begin(), found.end(), std::back_inserter(shortcuts));
+  }
+  checkedPairCount += pairs;
+  return shortcuts;
+}
+
+std::vector<Edge> MetricUpdate::checkNodes(const std::vector<NodePos>& nodes,
+    std::atomic<size_t>& next, NormalDijkstra& d, ContractionLp& lp, std::atomic<size_t>& pairs)
+{
+  std::vector<Edge> shortcuts;
+  std::vector<EdgeId> used;
+  for (size_t i = next++; i < nodes.size(); i = next++) {
+    auto node = nodes[i];
+    d.setMinLevel(g.getLevelOf(node));
+    auto outEdges = withAdded(g.getOutgoingEdgesOf(node), addedOut, node);
+    for (const auto& in : withAdded(g.getIngoingEdgesOf(node), addedIn, node)) {
+      if (!contractedBefore(node, in.end)) {
+        continue;
+      }
+      for (const auto& out : outEdges) {
+        if (!contractedBefore(node, out.end) || in.end == out.end || hasShortcut(in.id, out.id)) {
+          continue;
+        }
+        // Other pairs keep the cost of their shortcut and their witnesses
+        auto pair = std::make_pair(in.id, out.id);
+        if (!checkAllPairs && changedEdges.count(in.id) == 0 && changedEdges.count(out.id) == 0
+            && recheckedPairs.count(pair) == 0) {
+          continue;
+        }
+        ++pairs;
+        used.clear();
+        bool needed = needsShortcut(d, lp, in, out, node, used);
+        if (needed) {
+          auto shortcut = Contractor::createShortcut(Edge::getEdge(in.id), Edge::getEdge(out.id));
+          shortcut.sourcePos(in.end);
+          shortcut.destPos(out.end);
+          shortcuts.push_back(std::move(shortcut));
+        }
+        std::sort(used.begin(), used.end());
+        used.erase(std::unique(used.begin(), used.end()), used.end());
+        std::lock_guard guard(witnessKey);
+        if (needed) {
+          witnessEdges.erase(pair);
+        } else {
+          witnessEdges[pair] = used;
+        }
+      }
+    }
+  }
+  return shortcuts;
+}
+
+bool MetricUpdate::needsShortcut(NormalDijkstra& d, ContractionLp& lp, const HalfEdge& in,
+    const HalfEdge& out, NodePos node, std::vector<EdgeId>& used)
+{
+  const auto shortcutCost = in.cost + out.cost;
+  const auto level = g.getLevelOf(node);
+  std::vector<Cost> witnesses;
+  bool needed = false;
+
+  // Returns true if the result for this config decides the pair
+  auto test = [&](const Config& c) {
+    auto route = d.findBestRoute(in.end, out.end, c);
+    if (!route) {
+      needed = true;
+      return true;
+    }
+    if (route->costs == shortcutCost) {
+      // Like while contracting, a path of the same cost only replaces the shortcut if it does
+      // not lead over a node contracted in the same round
+      needed = route->pathCount == 1
+          || std::any_of(route->edges.begin(), route->edges.end(), [this, level](const auto& id) {
+               return g.getLevelOf(Edge::getEdge(id).destPos()) == level;
+             });
+      // The other paths of the same cost are not known
+      used.clear();
+      return true;
+    }
+    witnesses.push_back(route->costs);
+    used.insert(used.end(), route->edges.begin(), route->edges.end());
+    const auto& witness = route->costs;
+    bool dominated = true;
+    for (size_t i = 0; i < Cost::dim; ++i) {
+      dominated &= witness.values[i] <= shortcutCost.values[i] + COST_ACCURACY;
+    }
+    needed = false;
+    return dominated;
+  };
+
+  for (size_t i = 0; i < Cost::dim; ++i) {
+    std::vector<double> values(Cost::dim, 0);
+    values[i] = 1;
+    if (test(Config { values })) {
+      return needed;
+    }
+  }
+
+  Config config { std::vector(Cost::dim, 1.0 / Cost::dim) };
+  for (size_t calls = 0; calls < maxLpCalls; ++calls) {
+    for (const auto& w : witnesses) {
+      lp.addConstraint((w - shortcutCost).values);
+    }
+    if (!lp.solve()) {
+      return false;
+    }
+    Config newConfig { lp.variableValues() };
+    if (calls > 0 && newConfig == config) {
+      return true;
+    }
+    config = newConfig;
+    if (test(config)) {
+      return needed;
+    }
+  }
+  // Keeping an unnecessary shortcut does not change any shortest path
+  return true;
+}
+
+void MetricUpdate::rebuildGraph(const std::vector<EdgeId>& added)
+{
+  std::vector<Node> nodes;
+  nodes.reserve(g.getNodeCount());
+  std::vector<EdgeId> edges;
+  edges.reserve(g.getEdgeCount() + added.size());
+  for (size_t i = 0; i < g.getNodeCount(); ++i) {
+    NodePos pos { i };
+    nodes.push_back(g.getNode(pos));
+    for (const auto& e : g.getOutgoingEdgesOf(pos)) {
+      edges.push_back(e.id);
+    }
+  }
+  edges.insert(edges.end(), added.begin(), added.end());
+  g = Graph { std::move(nodes), std::move(edges) };
+}
+
+void MetricUpdate::writeWitnesses(const std::string& fileName) const
+{
+  std::ofstream file { fileName };
+  if (!file) {
+    throw std::invalid_argument("Could not open " + fileName);
+  }
+  file << Edge::edges.size() << ' ' << witnessesKnown << '\n';
+  for (const auto& [pair, used] : witnessEdges) {
+    file << pair.first << ' ' << pair.second << ' ' << used.size();
+    for (const auto& id : used) {
+      file << ' ' << id;
+    }
+    file << '\n';
+  }
+}
+
+void MetricUpdate::readWitnesses(const std::string& fileName)
+{
+  std::ifstream file { fileName };
+  if (!file) {
+    throw std::invalid_argument("Could not open " + fileName);
+  }
+  size_t edgeCount = 0;
+  bool known = false;
+  file >> edgeCount >> known;
+  if (!file || edgeCount != Edge::edges.size()) {
+    throw std::invalid_argument(fileName + " does not belong to a graph with "
+        + std::to_string(Edge::edges.size()) + " edges");
+  }
+  auto readId = [&file, &fileName]() {
+    size_t id = 0;
+    if (!(file >> id) || id >= Edge::edges.size()) {
+      throw std::invalid_argument(fileName + " contains an edge which does not exist");
+    }
+    return EdgeId { id };
+  };
+  std::map<std::pair<EdgeId, EdgeId>, std::vector<EdgeId>> edges;
+  while (file >> std::ws && !file.eof()) {
+    auto in = readId();
+    auto out = readId();
+    size_t count = 0;
+    if (!(file >> count)) {
+      throw std::invalid_argument(fileName + " is truncated");
+    }
+    std::vector<EdgeId> used;
+    for (size_t i = 0; i < count; ++i) {
+      used.push_back(readId());
+    }
+    edges[std::make_pair(in, out)] = std::move(used);
+  }
+  witnessEdges = std::move(edges);
+  witnessesKnown = known;
+}
+
+std::vector<CostChange> MetricUpdate::readChanges(const std::string& fileName)
+{
+  std::ifstream file { fileName };
+  if (!file) {
+    throw std::invalid_argument("Could not open " + fileName);
+  }
+  std::vector<CostChange> changes;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line.front() == '#') {
+      continue;
+    }
+    std::istringstream ss { line };
+    size_t id = 0;
+    Cost cost {};
+    ss >> id;
+    for (auto& value : cost.values) {
+      ss >> value;
+    }
+    if (!ss) {
+      throw std::invalid_argument(fileName + ": expected an edge id and "
+          + std::to_string(Cost::dim) + " costs in line \"" + line + "\"");
+    }
+    changes.push_back(CostChange { EdgeId { id }, cost });
+  }
+  return changes;
+}
+
+} // namespace MULTI_CH_DIM_NAMESPACE
@@ -0,0 +1,119 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef METRICUPDATE_H
+#define METRICUPDATE_H
+
+#include "ndijkstra.hpp"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_set>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+class ContractionLp;
+
+struct CostChange {
+  EdgeId edge;
+  Cost cost;
+};
+
+// Applies new costs of base edges to a contracted graph without contracting it again. The
+// shortcuts depending on a changed edge get the sum of the costs of their two edges, level by
+// level from the bottom. Then the edge pairs containing a changed edge are checked again like
+// during the contraction, with a witness search restricted to the nodes which were not
+// contracted yet. Every checked pair without a shortcut remembers the edges its witnesses used.
+// If an edge got more expensive, only the pairs whose witnesses used it are checked again. As
+// long as the witnesses of some pairs are unknown, an increase checks every pair below the core
+// once, in the node order of the contraction. Missing shortcuts are added, which touches the
+// pairs at their end nodes on higher levels. Shortcuts which are no longer needed are kept, they
+// do not change any shortest path.
+class MetricUpdate {
+  public:
+  MetricUpdate(Graph& g, size_t threadCount);
+  MetricUpdate(const MetricUpdate& other) = delete;
+  MetricUpdate(MetricUpdate&& other) = delete;
+  virtual ~MetricUpdate() noexcept;
+  MetricUpdate& operator=(const MetricUpdate& other) = delete;
+  MetricUpdate& operator=(MetricUpdate&& other) = delete;
+
+  // The graph is rebuilt once at the end if shortcuts have to be added
+  void update(const std::vector<CostChange>& changes);
+
+  // Reads lines of an edge id followed by the new costs of the edge
+  static std::vector<CostChange> readChanges(const std::string& fileName);
+
+  // The witnesses of the pairs stay valid for the graph written after the update
+  void writeWitnesses(const std::string& fileName) const;
+  void readWitnesses(const std::string& fileName);
+
+  // Statistics of the last update
+  size_t updatedShortcuts() const { return updatedShortcutCount; }
+  size_t checkedNodes() const { return checkedNodeCount; }
+  size_t checkedPairs() const { return checkedPairCount; }
+  size_t addedShortcuts() const { return addedShortcutCount; }
+
+  private:
+  // Shortcuts needed at the nodes of one level
+  std::vector<Edge> checkLevel(const std::vector<NodePos>& nodes);
+  std::vector<Edge> checkNodes(const std::vector<NodePos>& nodes, std::atomic<size_t>& next,
+      NormalDijkstra& d, ContractionLp& lp, std::atomic<size_t>& pairs);
+  bool hasShortcut(EdgeId in, EdgeId out) const;
+  bool contractedBefore(NodePos node, NodePos other) const;
+  // Fills used with the edges of the witnesses, empty if the pair depends on every edge
+  bool needsShortcut(NormalDijkstra& d, ContractionLp& lp, const HalfEdge& in,
+      const HalfEdge& out, NodePos node, std::vector<EdgeId>& used);
+  void addParents(EdgeId shortcut);
+  void rebuildGraph(const std::vector<EdgeId>& added);
+
+  static const size_t maxLpCalls = 100;
+
+  Graph& g;
+  size_t threadCount;
+  std::vector<std::unique_ptr<ContractionLp>> lps;
+  std::vector<NormalDijkstra> dijkstras;
+  // Shortcuts which contain an edge, indexed by the edge id
+  std::vector<std::vector<EdgeId>> parents;
+  // Edges of the current update with a new cost
+  std::unordered_set<EdgeId> changedEdges;
+  // Edges used by the witnesses of the pairs without a shortcut, by the in and out edge of the
+  // pair. An empty list means the pair depends on every edge.
+  std::map<std::pair<EdgeId, EdgeId>, std::vector<EdgeId>> witnessEdges;
+  std::mutex witnessKey;
+  // Set once every pair below the core was checked
+  bool witnessesKnown = false;
+  // Set if an edge got more expensive while the witnesses of some pairs are unknown
+  bool checkAllPairs = false;
+  // Pairs whose witnesses used an edge which got more expensive
+  std::set<std::pair<EdgeId, EdgeId>> recheckedPairs;
+  // Shortcuts added by the current update, which are not in the graph until it is rebuilt
+  AddedEdges addedOut;
+  AddedEdges addedIn;
+  size_t coreLevel = 0;
+
+  size_t updatedShortcutCount = 0;
+  size_t checkedNodeCount = 0;
+  size_t checkedPairCount = 0;
+  size_t addedShortcutCount = 0;
+};
+
+} // namespace MULTI_CH_DIM_NAMESPACE
+
+#endif /* METRICUPDATE_H */
@@ -19,6 +19,7 @@
 #ifndef MULTIQUEUE_H
 #define MULTIQUEUE_H
 
+#include <algorithm>
 #include <condition_variable>
 #include <deque>
 #include <mutex>
@@ -40,6 +41,7 @@ template <class T> class MultiQueue {
     std::unique_lock guard(key);
     non_full.wait(guard, [this] { return maxSize > fifo.size(); });
     fifo.push_back(value);
+    peakSize_ = std::max(peakSize_, fifo.size());
     non_empty.notify_one();
   }
 
@@ -54,6 +56,7 @@ template <class T> class MultiQueue {
     for (size_t i = 0; i < valueSize; ++i) {
       fifo.push_back(values[i]);
     }
+    peakSize_ = std::max(peakSize_, fifo.size());
     values.clear();
     non_empty.notify_all();
   }
@@ -95,6 +98,23 @@ template <class T> class MultiQueue {
     return container.size();
   }
 
+  // Like receive_some but never splits a group of consecutive elements for which sameGroup
+  // holds. Groups have to be sent as a whole to be received as a whole.
+  template <class SameGroup>
+  size_t receive_some(std::vector<T>& container, size_t some, SameGroup sameGroup)
+  {
+    std::unique_lock<std::mutex> guard(key);
+    non_empty.wait(guard, [this] { return !fifo.empty() || closed_; });
+    while (!fifo.empty()
+        && (container.size() < some
+            || (!container.empty() && sameGroup(container.back(), fifo.front())))) {
+      container.push_back(fifo.front());
+      fifo.pop_front();
+    }
+    non_full.notify_one();
+    return container.size();
+  }
+
   void close()
   {
     std::lock_guard guard(key);
@@ -112,6 +132,12 @@ template <class T> class MultiQueue {
     std::lock_guard guard(key);
     return fifo.size();
   }
+  // Largest number of elements that were buffered at the same time
+  size_t peakSize()
+  {
+    std::lock_guard guard(key);
+    return peakSize_;
+  }
 
   protected:
   private:
@@ -120,6 +146,7 @@ template <class T> class MultiQueue {
   std::condition_variable_any non_full;
   std::deque<T> fifo;
   size_t maxSize;
+  size_t peakSize_ = 0;
   bool closed_ = false;
 };
 
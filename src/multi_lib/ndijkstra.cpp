@@ -16,9 +16,12 @@
   along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include "ndijkstra.hpp"
+#include "prefetch.hpp"
 #include <fstream>
 #include <unordered_set>
 
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
 NormalDijkstra::NormalDijkstra(Graph* g, size_t nodeCount, bool unpack)
     : cost(nodeCount, std::numeric_limits<double>::max())
     , paths(nodeCount, 0)
@@ -56,12 +59,15 @@ std::optional<RouteWithCount> NormalDijkstra::findBestRoute(
     if (pathCost > cost[node]) {
       continue;
     }
+    ++settled;
 
     const auto& outEdges = graph->getOutgoingEdgesOf(node);
-    for (const auto& edge : outEdges) {
-      if (unpack && Edge::getEdge(edge.id).getEdgeA()) {
-        continue;
+    if constexpr (prefetching) {
+      for (const auto& edge : outEdges) {
+        prefetch(&cost[edge.end]);
       }
+    }
+    auto relax = [&, node = node, pathCost = pathCost](const HalfEdge& edge) {
       const NodePos& nextNode = edge.end;
       double nextCost = pathCost + edge.costByConfiguration(config);
       if (nextCost < cost[nextNode]) {
@@ -77,6 +83,33 @@ std::optional<RouteWithCount> NormalDijkstra::findBestRoute(
         paths[nextNode] += paths[node];
         previousEdge[nextNode].push_back(edge);
       }
+    };
+    for (const auto& edge : outEdges) {
+      if (unpack && Edge::getEdge(edge.id).getEdgeA()) {
+        continue;
+      }
+      // Edges are sorted by the level of their end, so all further ends are below too
+      if (minLevel > 0 && graph->getLevelOf(edge.end) < minLevel) {
+        break;
+      }
+      relax(edge);
+    }
+    // Added edges are shortcuts
+    if (addedEdges && !unpack) {
+      auto added = addedEdges->find(node);
+      if (added != addedEdges->end()) {
+        for (const auto& edge : added->second) {
+          if (graph->getLevelOf(edge.end) >= minLevel) {
+            relax(edge);
+          }
+        }
+      }
+    }
+    // The edges of the next node are needed right away
+    if constexpr (prefetching) {
+      if (!heap.empty()) {
+        prefetch(&graph->getOffsets()[std::get<NodePos>(heap.top())]);
+      }
     }
   }
 }
@@ -94,7 +127,19 @@ void NormalDijkstra::clearState()
   touched.clear();
   pathCost = Cost{};
   pathCount = 0;
+  settled = 0;
 }
+size_t NormalDijkstra::memoryUsage() const
+{
+  size_t bytes = cost.capacity() * sizeof(double) + touched.capacity() * sizeof(NodePos)
+      + paths.capacity() * sizeof(size_t)
+      + previousEdge.capacity() * sizeof(std::vector<HalfEdge>);
+  for (const auto& edges : previousEdge) {
+    bytes += edges.capacity() * sizeof(HalfEdge);
+  }
+  return bytes;
+}
+
 void insertUnpackedEdge(const Edge& e, std::deque<EdgeId>& route, bool front)
 {
   const auto& edgeA = e.getEdgeA();
@@ -233,3 +278,5 @@ void NormalDijkstra::saveDotGraph(const EdgeId& inId, const EdgeId& outId)
   }
   dotFile << "}" << '\n';
 }
+
+} // namespace MULTI_CH_DIM_NAMESPACE
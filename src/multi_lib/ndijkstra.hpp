@@ -21,6 +21,8 @@
 #include <queue>
 #include <unordered_map>
 
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
 struct RouteWithCount {
   Cost costs;
   size_t pathCount = 1;
@@ -41,6 +43,9 @@ struct BiggerPathCost {
 };
 using Queue = std::priority_queue<QueueElem, std::vector<QueueElem>, BiggerPathCost>;
 
+// Outgoing edges which are not part of the graph yet, by their begin
+using AddedEdges = std::unordered_map<NodePos, std::vector<HalfEdge>>;
+
 class NormalDijkstra {
   public:
   NormalDijkstra(Graph* g, size_t nodeCount, bool unpack = false);
@@ -55,21 +60,34 @@ class NormalDijkstra {
 
   void saveDotGraph(const EdgeId& inId, const EdgeId& outId);
 
+  // Bytes allocated for the per node search state
+  size_t memoryUsage() const;
+  // Nodes settled by the last search
+  size_t settledNodes() const { return settled; }
+  // Skips nodes below this level, so a contracted graph is searched like the graph in which
+  // this level was contracted
+  void setMinLevel(size_t level) { minLevel = level; }
+  // Relaxes these edges too, so edges can be added without rebuilding the graph
+  void setAddedEdges(const AddedEdges* edges) { addedEdges = edges; }
+
   friend RouteIterator;
 
   private:
   void clearState();
   RouteWithCount buildRoute(const NodePos& from, const NodePos& to);
 
-  std::vector<double> cost;
+  HugeVector<double> cost;
   std::vector<NodePos> touched;
-  std::vector<size_t> paths;
+  HugeVector<size_t> paths;
   std::vector<std::vector<HalfEdge>> previousEdge;
 
   NodePos from, to;
 
   Cost pathCost;
   size_t pathCount;
+  size_t settled = 0;
+  size_t minLevel = 0;
+  const AddedEdges* addedEdges = nullptr;
 
   Config usedConfig;
   Graph* graph;
@@ -113,4 +131,7 @@ class RouteIterator {
       = std::priority_queue<RouteQueueElem, std::vector<RouteQueueElem>, BiggerRouteCost>;
   RouteQueue heap;
 };
+
+} // namespace MULTI_CH_DIM_NAMESPACE
+
 #endif /* NDIJKSTRA_H */
@@ -18,6 +18,8 @@
 #include "graph.hpp"
 #include <boost/exception/exception.hpp>
 
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
 Node::Node(const std::string external_id, NodeId id)
     : external_node_id_(external_id)
     , id_(id)
@@ -87,3 +89,5 @@ void Node::writeToStream(std::ostream& out) const
 }
 
 const std::string& Node::external_id() const { return external_node_id_; }
+
+} // namespace MULTI_CH_DIM_NAMESPACE
@@ -0,0 +1,344 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "partition.hpp"
+#include "contractor.hpp"
+#include <boost/filesystem.hpp>
+#include <sys/wait.h>
+#include <tuple>
+#include <unistd.h>
+#include <unordered_map>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+using CellPoint = std::tuple<double, double, NodePos>;
+
+void bisect(std::vector<CellPoint>::iterator begin, std::vector<CellPoint>::iterator end,
+    size_t firstCell, size_t cells, std::vector<size_t>& cellOf)
+{
+  if (cells <= 1 || end - begin < 2) {
+    for (auto it = begin; it != end; ++it) {
+      cellOf[std::get<NodePos>(*it)] = firstCell;
+    }
+    return;
+  }
+
+  auto [minLat, maxLat] = std::minmax_element(begin, end,
+      [](const auto& a, const auto& b) { return std::get<0>(a) < std::get<0>(b); });
+  auto [minLng, maxLng] = std::minmax_element(begin, end,
+      [](const auto& a, const auto& b) { return std::get<1>(a) < std::get<1>(b); });
+  bool byLat = std::get<0>(*maxLat) - std::get<0>(*minLat)
+      >= std::get<1>(*maxLng) - std::get<1>(*minLng);
+
+  size_t leftCells = cells / 2;
+  auto middle = begin + (end - begin) * leftCells / cells;
+  std::nth_element(begin, middle, end, [byLat](const auto& a, const auto& b) {
+    return byLat ? std::get<0>(a) < std::get<0>(b) : std::get<1>(a) < std::get<1>(b);
+  });
+
+  bisect(begin, middle, firstCell, leftCells, cellOf);
+  bisect(middle, end, firstCell + leftCells, cells - leftCells, cellOf);
+}
+
+PartitionContractor::PartitionContractor(size_t cellCount, bool printStatistics, size_t maxThreads)
+    : cellCount(std::max<size_t>(1, cellCount))
+    , printStatistics(printStatistics)
+    , maxThreads(std::max<size_t>(1, maxThreads))
+{
+}
+
+void PartitionContractor::setDeterministic(bool value) { deterministic = value; }
+
+void PartitionContractor::setAsync(bool value) { async = value; }
+
+void PartitionContractor::setWitnessCache(bool value) { witnessCache = value; }
+
+void PartitionContractor::setPairBudget(const PairBudget& value) { pairBudget = value; }
+
+void PartitionContractor::setConfigRegions(bool value) { configRegions = value; }
+
+std::vector<size_t> PartitionContractor::partition(const Graph& g) const
+{
+  const auto& graph_properties = get_graph_properties();
+  auto coordinates = [&g, &graph_properties](NodePos pos) {
+    size_t id = g.getNode(pos).id();
+    return std::make_pair(
+        get<double>("lat", graph_properties, id), get<double>("lng", graph_properties, id));
+  };
+
+  bool useCoordinates = g.getNodeCount() > 0;
+  try {
+    if (useCoordinates) {
+      coordinates(NodePos { 0 });
+    }
+  } catch (std::exception& e) {
+    std::cout << "No coordinates found, partitioning by node position" << '\n';
+    useCoordinates = false;
+  }
+
+  std::vector<CellPoint> points;
+  points.reserve(g.getNodeCount());
+  for (size_t i = 0; i < g.getNodeCount(); ++i) {
+    NodePos pos { i };
+    if (useCoordinates) {
+      auto [lat, lng] = coordinates(pos);
+      points.emplace_back(lat, lng, pos);
+    } else {
+      points.emplace_back(static_cast<double>(i), 0.0, pos);
+    }
+  }
+
+  std::vector<size_t> cellOf(g.getNodeCount(), 0);
+  bisect(points.begin(), points.end(), 0, cellCount, cellOf);
+  return cellOf;
+}
+
+void PartitionContractor::contractCell(Graph& g, const std::vector<size_t>& cells,
+    const std::vector<bool>& boundary, size_t cell, double rest,
+    const std::string& resultFile) const
+{
+  size_t firstShortcut = Edge::edges.size();
+
+  std::vector<Node> nodes {};
+  std::vector<EdgeId> edges {};
+  std::unordered_set<NodeId> frozen {};
+  for (size_t i = 0; i < g.getNodeCount(); ++i) {
+    NodePos pos { i };
+    if (cells[pos] != cell) {
+      continue;
+    }
+    nodes.push_back(g.getNode(pos));
+    if (boundary[pos]) {
+      frozen.insert(g.getNode(pos).id());
+    }
+    for (const auto& edge : g.getOutgoingEdgesOf(pos)) {
+      if (cells[edge.end] == cell) {
+        edges.push_back(edge.id);
+      }
+    }
+  }
+  size_t frozenCount = frozen.size();
+  // Stop like contractCompletely once only rest percent of the interior is left
+  size_t keep = static_cast<size_t>((nodes.size() - frozenCount) * rest / 100);
+
+  Graph cellGraph { std::move(nodes), std::move(edges) };
+  Contractor c { printStatistics, std::max<size_t>(1, maxThreads / cellCount) };
+  c.setDeterministic(deterministic);
+  c.setAsync(async);
+  c.setWitnessCache(witnessCache);
+  c.setPairBudget(pairBudget);
+  c.freeze(std::move(frozen));
+  while (cellGraph.getNodeCount() > frozenCount + keep) {
+    size_t nodeCount = cellGraph.getNodeCount();
+    cellGraph = c.contract(cellGraph);
+    if (cellGraph.getNodeCount() == nodeCount) {
+      break;
+    }
+  }
+
+  std::ofstream out { resultFile };
+  const auto& contracted = c.getContractedNodes();
+  out << contracted.size() << '\n';
+  for (const auto& node : contracted) {
+    out << node.id() << ' ' << node.getLevel() << '\n';
+  }
+
+  out << Edge::edges.size() - firstShortcut << '\n';
+  for (size_t i = firstShortcut; i < Edge::edges.size(); ++i) {
+    const auto& shortcut = Edge::edges[i];
+    out << *shortcut.getEdgeA() << ' ' << *shortcut.getEdgeB() << '\n';
+  }
+
+  std::vector<EdgeId> remaining {};
+  for (size_t i = 0; i < cellGraph.getNodeCount(); ++i) {
+    for (const auto& edge : cellGraph.getOutgoingEdgesOf(NodePos { i })) {
+      remaining.push_back(edge.id);
+    }
+  }
+  out << remaining.size() << '\n';
+  for (const auto& id : remaining) {
+    out << id << '\n';
+  }
+  if (!out) {
+    throw std::runtime_error("Could not write result of cell " + std::to_string(cell));
+  }
+}
+
+PartitionContractor::CellResult PartitionContractor::readCellResult(const std::string& resultFile)
+{
+  std::ifstream in { resultFile };
+  CellResult result {};
+  size_t count = 0;
+
+  in >> count;
+  result.contractedNodes.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    size_t id, level;
+    in >> id >> level;
+    result.contractedNodes.emplace_back(NodeId { id }, level);
+  }
+
+  in >> count;
+  result.shortcuts.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    size_t edgeA, edgeB;
+    in >> edgeA >> edgeB;
+    result.shortcuts.emplace_back(EdgeId { edgeA }, EdgeId { edgeB });
+  }
+
+  in >> count;
+  result.remainingEdges.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    size_t id;
+    in >> id;
+    result.remainingEdges.emplace_back(id);
+  }
+
+  if (!in) {
+    throw std::runtime_error("Could not read cell result " + resultFile);
+  }
+  return result;
+}
+
+Graph PartitionContractor::contractCompletely(Graph& g, double rest)
+{
+  size_t nodeCount = g.getNodeCount();
+  auto cells = partition(g);
+
+  std::vector<bool> boundary(nodeCount, false);
+  std::vector<EdgeId> overlayEdges {};
+  for (size_t i = 0; i < nodeCount; ++i) {
+    NodePos pos { i };
+    for (const auto& edge : g.getOutgoingEdgesOf(pos)) {
+      if (cells[pos] != cells[edge.end]) {
+        boundary[pos] = true;
+        boundary[edge.end] = true;
+        overlayEdges.push_back(edge.id);
+      }
+    }
+  }
+  std::cout << "Partitioned graph into " << cellCount << " cells with "
+            << std::count(boundary.begin(), boundary.end(), true) << " boundary nodes" << '\n';
+
+  std::vector<std::string> resultFiles {};
+  for (size_t cell = 0; cell < cellCount; ++cell) {
+    auto file = boost::filesystem::temp_directory_path()
+        / boost::filesystem::unique_path("multi-ch-cell-%%%%-%%%%-%%%%");
+    resultFiles.push_back(file.string());
+  }
+
+  // Contract at most maxThreads cells at the same time, every cell in its own process
+  size_t parallelCells = std::min(cellCount, maxThreads);
+  for (size_t first = 0; first < cellCount; first += parallelCells) {
+    std::cout.flush();
+    std::cerr.flush();
+    std::vector<std::pair<pid_t, size_t>> workers {};
+    for (size_t cell = first; cell < std::min(cellCount, first + parallelCells); ++cell) {
+      pid_t pid = fork();
+      if (pid < 0) {
+        throw std::runtime_error("Could not start worker for cell " + std::to_string(cell));
+      }
+      if (pid == 0) {
+        int status = 0;
+        try {
+          contractCell(g, cells, boundary, cell, rest, resultFiles[cell]);
+        } catch (std::exception& e) {
+          std::cerr << "Contracting cell " << cell << " failed: " << e.what() << '\n';
+          status = 1;
+        }
+        std::cout.flush();
+        std::cerr.flush();
+        _exit(status);
+      }
+      workers.emplace_back(pid, cell);
+    }
+    for (const auto& [pid, cell] : workers) {
+      int status = 0;
+      waitpid(pid, &status, 0);
+      if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw std::runtime_error("Worker for cell " + std::to_string(cell) + " failed");
+      }
+    }
+  }
+
+  std::unordered_map<NodeId, NodePos> posById {};
+  posById.reserve(nodeCount);
+  for (size_t i = 0; i < nodeCount; ++i) {
+    posById[g.getNode(NodePos { i }).id()] = NodePos { i };
+  }
+
+  size_t firstShortcut = Edge::edges.size();
+  size_t level = 0;
+  std::vector<bool> contracted(nodeCount, false);
+  std::vector<Node> contractedNodes {};
+  for (size_t cell = 0; cell < cellCount; ++cell) {
+    auto result = readCellResult(resultFiles[cell]);
+    boost::filesystem::remove(resultFiles[cell]);
+
+    for (const auto& [id, nodeLevel] : result.contractedNodes) {
+      auto pos = posById.at(id);
+      contracted[pos] = true;
+      Node node = g.getNode(pos);
+      node.assignLevel(nodeLevel);
+      contractedNodes.push_back(node);
+      level = std::max(level, nodeLevel);
+    }
+
+    // Every worker numbered its shortcuts from firstShortcut on, move them into one id space
+    std::unordered_map<EdgeId, EdgeId> ids {};
+    auto mapId = [&ids, firstShortcut](EdgeId id) { return id < firstShortcut ? id : ids.at(id); };
+    size_t workerId = firstShortcut;
+    for (const auto& [edgeA, edgeB] : result.shortcuts) {
+      std::vector<Edge> shortcut {};
+      shortcut.push_back(
+          Contractor::createShortcut(Edge::getEdge(mapId(edgeA)), Edge::getEdge(mapId(edgeB))));
+      ids[EdgeId { workerId++ }] = Edge::administerEdges(std::move(shortcut)).front();
+    }
+    for (const auto& id : result.remainingEdges) {
+      overlayEdges.push_back(mapId(id));
+    }
+  }
+
+  std::vector<Node> overlayNodes {};
+  for (size_t i = 0; i < nodeCount; ++i) {
+    if (!contracted[i]) {
+      overlayNodes.push_back(g.getNode(NodePos { i }));
+    }
+  }
+  std::cout << "Cells contracted " << contractedNodes.size() << " nodes with "
+            << Edge::edges.size() - firstShortcut << " shortcuts, " << overlayNodes.size()
+            << " nodes are left for the overlay" << '\n';
+
+  Contractor overlay { printStatistics, maxThreads };
+  overlay.setDeterministic(deterministic);
+  overlay.setAsync(async);
+  overlay.setWitnessCache(witnessCache);
+  overlay.setPairBudget(pairBudget);
+  overlay.setConfigRegions(configRegions);
+  overlay.addContracted(std::move(contractedNodes), level);
+  size_t overlayNodeCount = overlayNodes.size();
+  Graph overlayGraph { std::move(overlayNodes), std::move(overlayEdges) };
+  if (overlayNodeCount == 0) {
+    return overlay.mergeWithContracted(overlayGraph);
+  }
+
+  // rest refers to the whole graph, contractCompletely to the overlay only
+  double overlayRest = std::min(100.0, rest * nodeCount / overlayNodeCount);
+  return overlay.contractCompletely(overlayGraph, overlayRest);
+}
+
+} // namespace MULTI_CH_DIM_NAMESPACE
@@ -0,0 +1,73 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include "contractor.hpp"
+#include "graph.hpp"
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+// Splits the graph into cells and contracts the interior of every cell in its own worker
+// process. Witness searches of a worker only see the nodes of its cell. Afterwards the overlay
+// of all boundary nodes is contracted as usual.
+class PartitionContractor {
+  public:
+  PartitionContractor(size_t cellCount, bool printStatistics, size_t maxThreads);
+  PartitionContractor(const PartitionContractor& other) = delete;
+  PartitionContractor(PartitionContractor&& other) = delete;
+  virtual ~PartitionContractor() noexcept = default;
+  PartitionContractor& operator=(const PartitionContractor& other) = delete;
+  PartitionContractor& operator=(PartitionContractor&& other) = delete;
+
+  void setDeterministic(bool value);
+  void setAsync(bool value);
+  void setWitnessCache(bool value);
+  void setPairBudget(const PairBudget& value);
+  // Only shortcuts of the overlay get config regions
+  void setConfigRegions(bool value);
+
+  // Cell of every node position, cut by the median of the longer side of the bounding box
+  std::vector<size_t> partition(const Graph& g) const;
+
+  Graph contractCompletely(Graph& g, double rest = 2);
+
+  private:
+  struct CellResult {
+    std::vector<std::pair<NodeId, size_t>> contractedNodes;
+    std::vector<std::pair<EdgeId, EdgeId>> shortcuts;
+    std::vector<EdgeId> remainingEdges;
+  };
+
+  void contractCell(Graph& g, const std::vector<size_t>& cells, const std::vector<bool>& boundary,
+      size_t cell, double rest, const std::string& resultFile) const;
+  static CellResult readCellResult(const std::string& resultFile);
+
+  size_t cellCount;
+  bool printStatistics;
+  size_t maxThreads;
+  bool deterministic = false;
+  bool async = false;
+  bool witnessCache = false;
+  PairBudget pairBudget;
+  bool configRegions = false;
+};
+
+} // namespace MULTI_CH_DIM_NAMESPACE
+
+#endif /* PARTITION_H */
@@ -0,0 +1,171 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+// Places threads, processes and memory on the cores and NUMA nodes of the machine. Everything
+// is best effort: without the needed information or permissions nothing is changed.
+class Placement {
+  public:
+  // Core for a worker, consecutive workers alternate between the NUMA nodes
+  static int cpuOfWorker(size_t worker)
+  {
+    const auto& cpus = spreadCpus();
+    if (cpus.empty()) {
+      return static_cast<int>(worker % std::max(1L, sysconf(_SC_NPROCESSORS_ONLN)));
+    }
+    return cpus[worker % cpus.size()];
+  }
+
+  static void pinThread(int cpu)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+
+  static void pinProcess(pid_t pid, int cpu)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(pid, sizeof(set), &set);
+  }
+
+  static size_t nodeCount() { return nodeCpus().size(); }
+
+  // Spreads the pages of a read mostly array round robin over all NUMA nodes, so threads on
+  // every node share the remote accesses instead of all but one node reading remotely
+  template <class Vector> static void interleave(const Vector& v)
+  {
+    interleave(v.data(), v.data() + v.size());
+  }
+
+  // Pages of the range which are already placed are moved, the others are placed round robin
+  // when they are first touched
+  template <class T> static void interleave(const T* first, const T* last)
+  {
+    if (nodeCount() < 2 || first == last) {
+      return;
+    }
+    const auto pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    auto begin = reinterpret_cast<uintptr_t>(first) & ~(pageSize - 1);
+    auto end = reinterpret_cast<uintptr_t>(last);
+    const auto& mask = onlineNodeMask();
+    // The kernel ignores the last bit of maxnode
+    syscall(SYS_mbind, begin, end - begin, MPOL_INTERLEAVE, mask.data(),
+        mask.size() * sizeof(unsigned long) * 8 + 1, MPOL_MF_MOVE);
+  }
+
+  private:
+  // Parses lists like "0-3,8-11"
+  static std::vector<int> parseList(const std::string& list)
+  {
+    std::vector<int> result;
+    std::stringstream ss { list };
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+      if (range.empty() || range == "\n") {
+        continue;
+      }
+      auto dash = range.find('-');
+      int first = std::stoi(range.substr(0, dash));
+      int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      for (int i = first; i <= last; ++i) {
+        result.push_back(i);
+      }
+    }
+    return result;
+  }
+
+  static std::string readLine(const std::string& file)
+  {
+    std::ifstream in { file };
+    std::string line;
+    std::getline(in, line);
+    return line;
+  }
+
+  static const std::vector<std::vector<int>>& nodeCpus()
+  {
+    static const std::vector<std::vector<int>> cpus = [] {
+      std::vector<std::vector<int>> result;
+      for (int node : parseList(readLine("/sys/devices/system/node/online"))) {
+        auto list = parseList(
+            readLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"));
+        if (!list.empty()) {
+          result.push_back(std::move(list));
+        }
+      }
+      return result;
+    }();
+    return cpus;
+  }
+
+  // Node ids may have gaps, so the mask is built from the online nodes
+  static const std::vector<unsigned long>& onlineNodeMask()
+  {
+    static const std::vector<unsigned long> mask = [] {
+      const size_t bits = sizeof(unsigned long) * 8;
+      std::vector<unsigned long> result;
+      for (int node : parseList(readLine("/sys/devices/system/node/online"))) {
+        auto word = static_cast<size_t>(node) / bits;
+        if (result.size() <= word) {
+          result.resize(word + 1, 0);
+        }
+        result[word] |= 1UL << (static_cast<size_t>(node) % bits);
+      }
+      return result;
+    }();
+    return mask;
+  }
+
+  static const std::vector<int>& spreadCpus()
+  {
+    static const std::vector<int> cpus = [] {
+      std::vector<int> result;
+      const auto& nodes = nodeCpus();
+      for (size_t i = 0, added = 1; added > 0; ++i) {
+        added = 0;
+        for (const auto& node : nodes) {
+          if (i < node.size()) {
+            result.push_back(node[i]);
+            ++added;
+          }
+        }
+      }
+      return result;
+    }();
+    return cpus;
+  }
+};
+
+#endif /* PLACEMENT_H */
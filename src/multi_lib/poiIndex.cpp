@@ -0,0 +1,297 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "poiIndex.hpp"
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <tuple>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+namespace {
+const double unreached = std::numeric_limits<double>::max();
+
+bool dominates(const Cost& a, const Cost& b)
+{
+  for (size_t i = 0; i < Cost::dim; ++i) {
+    if (a.values[i] > b.values[i] + COST_ACCURACY) {
+      return false;
+    }
+  }
+  return true;
+}
+
+double sum(const Cost& c)
+{
+  double result = 0;
+  for (auto value : c.values) {
+    result += value;
+  }
+  return result;
+}
+
+// Cost of the k-th nearest POI found so far
+double kthCost(const std::unordered_map<NodePos, double>& best, size_t k)
+{
+  if (best.size() < k) {
+    return unreached;
+  }
+  std::vector<double> found;
+  for (const auto& [poi, poiCost] : best) {
+    found.push_back(poiCost);
+  }
+  std::nth_element(found.begin(), found.begin() + (k - 1), found.end());
+  return found[k - 1];
+}
+}
+
+PoiIndex::PoiIndex(Graph& g, size_t maxLabels)
+    : g(g)
+    , maxLabels(maxLabels)
+    , exact(g.createDijkstra())
+    , buckets(g.getNodeCount())
+    , bounds(g.getNodeCount())
+    , costs(g.getNodeCount(), unreached)
+{
+}
+
+bool PoiIndex::insertLabel(Labels& labels, NodePos node, const Cost& cost)
+{
+  auto& known = labels[node];
+  for (const auto& label : known) {
+    if (dominates(label, cost)) {
+      return false;
+    }
+  }
+  known.erase(std::remove_if(known.begin(), known.end(),
+                  [&cost](const Cost& label) { return dominates(cost, label); }),
+      known.end());
+  if (known.size() >= maxLabels) {
+    ++dropped;
+    return false;
+  }
+  known.push_back(cost);
+  return true;
+}
+
+void PoiIndex::add(NodePos poi)
+{
+  if (pois.count(poi) > 0) {
+    return;
+  }
+  using QueueElem = std::tuple<double, NodePos, Cost>;
+  auto greater
+      = [](const QueueElem& a, const QueueElem& b) { return std::get<0>(a) > std::get<0>(b); };
+  std::priority_queue<QueueElem, std::vector<QueueElem>, decltype(greater)> heap { greater };
+
+  size_t droppedBefore = dropped;
+  Labels labels;
+  insertLabel(labels, poi, Cost {});
+  heap.emplace(0, poi, Cost {});
+  while (!heap.empty()) {
+    auto [key, node, cost] = heap.top();
+    heap.pop();
+    const auto& known = labels[node];
+    if (std::find(known.begin(), known.end(), cost) == known.end()) {
+      continue;
+    }
+    auto myLevel = g.getLevelOf(node);
+    for (const auto& edge : g.getIngoingEdgesOf(node)) {
+      if (g.getLevelOf(edge.end) < myLevel) {
+        break;
+      }
+      auto next = cost + edge.cost;
+      if (insertLabel(labels, edge.end, next)) {
+        heap.emplace(sum(next), edge.end, next);
+      }
+    }
+  }
+
+  auto& nodes = pois[poi];
+  for (const auto& [node, nodeLabels] : labels) {
+    for (const auto& cost : nodeLabels) {
+      buckets[node].push_back(Entry { poi, cost });
+      ++entryCount;
+    }
+    nodes.push_back(node);
+  }
+  // Bucket costs of this POI are too expensive for some configs
+  if (dropped > droppedBefore) {
+    truncated.insert(poi);
+    for (const auto& [node, cost] : lowerBounds(poi)) {
+      bounds[node].push_back(Entry { poi, cost });
+      if (labels.count(node) == 0) {
+        nodes.push_back(node);
+      }
+    }
+  }
+}
+
+std::unordered_map<NodePos, Cost> PoiIndex::lowerBounds(NodePos poi) const
+{
+  using QueueElem = std::pair<double, NodePos>;
+  std::priority_queue<QueueElem, std::vector<QueueElem>, std::greater<>> heap;
+  std::unordered_map<NodePos, Cost> result;
+  result[poi] = Cost {};
+  heap.emplace(0, poi);
+  while (!heap.empty()) {
+    auto [key, node] = heap.top();
+    heap.pop();
+    const auto cost = result[node];
+    if (key > sum(cost)) {
+      continue;
+    }
+    auto myLevel = g.getLevelOf(node);
+    for (const auto& edge : g.getIngoingEdgesOf(node)) {
+      if (g.getLevelOf(edge.end) < myLevel) {
+        break;
+      }
+      auto next = cost + edge.cost;
+      auto known = result.find(edge.end);
+      if (known == result.end()) {
+        result.emplace(edge.end, next);
+        heap.emplace(sum(next), edge.end);
+        continue;
+      }
+      bool improved = false;
+      for (size_t i = 0; i < Cost::dim; ++i) {
+        if (next.values[i] < known->second.values[i]) {
+          known->second.values[i] = next.values[i];
+          improved = true;
+        }
+      }
+      if (improved) {
+        heap.emplace(sum(known->second), edge.end);
+      }
+    }
+  }
+  return result;
+}
+
+void PoiIndex::remove(NodePos poi)
+{
+  auto nodes = pois.find(poi);
+  if (nodes == pois.end()) {
+    return;
+  }
+  auto ofPoi = [poi](const Entry& e) { return e.poi == poi; };
+  for (auto node : nodes->second) {
+    auto& bucket = buckets[node];
+    auto end = std::remove_if(bucket.begin(), bucket.end(), ofPoi);
+    entryCount -= bucket.end() - end;
+    bucket.erase(end, bucket.end());
+    auto& nodeBounds = bounds[node];
+    nodeBounds.erase(std::remove_if(nodeBounds.begin(), nodeBounds.end(), ofPoi), nodeBounds.end());
+  }
+  pois.erase(nodes);
+  truncated.erase(poi);
+}
+
+std::vector<std::pair<NodePos, double>> PoiIndex::findNearest(
+    NodePos from, const Config& c, size_t k)
+{
+  if (k == 0) {
+    return {};
+  }
+  for (auto node : touched) {
+    costs[node] = unreached;
+  }
+  touched.clear();
+
+  using QueueElem = std::pair<double, NodePos>;
+  std::priority_queue<QueueElem, std::vector<QueueElem>, std::greater<>> heap;
+  heap.emplace(0, from);
+  costs[from] = 0;
+  touched.push_back(from);
+
+  // Costs of truncated POIs are upper bounds until they are checked exactly
+  std::unordered_map<NodePos, double> best;
+  std::unordered_map<NodePos, double> lower;
+  double bound = unreached;
+  bool boundOutdated = false;
+  // Nodes not settled are at least this far away
+  double unsettled = unreached;
+  while (!heap.empty()) {
+    auto [cost, node] = heap.top();
+    heap.pop();
+    if (cost > costs[node]) {
+      continue;
+    }
+    if (boundOutdated) {
+      bound = kthCost(best, k);
+      boundOutdated = false;
+    }
+    if (cost >= bound) {
+      unsettled = cost;
+      break;
+    }
+    for (const auto& entry : buckets[node]) {
+      double candidate = cost + entry.cost * c;
+      auto known = best.find(entry.poi);
+      if (known == best.end() || candidate < known->second) {
+        best[entry.poi] = candidate;
+        boundOutdated = true;
+      }
+    }
+    for (const auto& entry : bounds[node]) {
+      double candidate = cost + entry.cost * c;
+      auto known = lower.find(entry.poi);
+      if (known == lower.end() || candidate < known->second) {
+        lower[entry.poi] = candidate;
+      }
+    }
+    auto myLevel = g.getLevelOf(node);
+    for (const auto& edge : g.getOutgoingEdgesOf(node)) {
+      if (g.getLevelOf(edge.end) < myLevel) {
+        break;
+      }
+      double next = cost + edge.costByConfiguration(c);
+      if (next < costs[edge.end]) {
+        costs[edge.end] = next;
+        touched.push_back(edge.end);
+        heap.emplace(next, edge.end);
+      }
+    }
+  }
+
+  // Only truncated POIs which may still beat the k-th result need a CH query
+  bound = kthCost(best, k);
+  for (auto poi : truncated) {
+    auto known = lower.find(poi);
+    double poiBound = std::min(known == lower.end() ? unreached : known->second, unsettled);
+    if (poiBound >= bound) {
+      continue;
+    }
+    ++exactCount;
+    if (auto route = exact.findBestRoute(from, poi, c)) {
+      best[poi] = route->costs * c;
+    } else {
+      best.erase(poi);
+    }
+  }
+
+  std::vector<std::pair<NodePos, double>> result(best.begin(), best.end());
+  std::sort(result.begin(), result.end(),
+      [](const auto& a, const auto& b) { return a.second < b.second; });
+  if (result.size() > k) {
+    result.resize(k);
+  }
+  return result;
+}
+
+} // namespace MULTI_CH_DIM_NAMESPACE
@@ -0,0 +1,86 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef POIINDEX_H
+#define POIINDEX_H
+
+#include "dijkstra.hpp"
+#include <unordered_set>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+// Finds the nearest points of interest with buckets on a contraction hierarchy. Adding a POI
+// runs a backward upward search from it and stores the costs of the paths at every reached node.
+// Since the config of a query is unknown in advance, the search keeps all pareto optimal costs
+// instead of one distance. A query runs one forward upward search and scans the buckets of the
+// settled nodes. POIs can be added and removed at any time without contracting again. The number
+// of costs per node is bounded. POIs which lose costs to this bound also store componentwise
+// minimal costs as lower bounds and get a CH query only if these bounds can beat the k-th result.
+class PoiIndex {
+  public:
+  PoiIndex(Graph& g, size_t maxLabels = 32);
+  PoiIndex(const PoiIndex& other) = delete;
+  PoiIndex(PoiIndex&& other) = delete;
+  virtual ~PoiIndex() noexcept = default;
+  PoiIndex& operator=(const PoiIndex& other) = delete;
+  PoiIndex& operator=(PoiIndex&& other) = delete;
+
+  void add(NodePos poi);
+  void remove(NodePos poi);
+
+  // The k nearest POIs with their cost for the config, nearest first
+  std::vector<std::pair<NodePos, double>> findNearest(NodePos from, const Config& c, size_t k);
+
+  size_t size() const { return pois.size(); }
+  size_t bucketEntries() const { return entryCount; }
+  // Pareto optimal costs dropped because a node had more than maxLabels of them
+  size_t droppedLabels() const { return dropped; }
+  // POIs which lost costs and may need a CH query instead of their buckets
+  size_t exactPois() const { return truncated.size(); }
+  // CH queries run for these POIs so far
+  size_t exactQueries() const { return exactCount; }
+
+  private:
+  struct Entry {
+    NodePos poi;
+    Cost cost;
+  };
+  using Labels = std::unordered_map<NodePos, std::vector<Cost>>;
+  bool insertLabel(Labels& labels, NodePos node, const Cost& cost);
+  // Componentwise minimal costs of the upward paths to the POI
+  std::unordered_map<NodePos, Cost> lowerBounds(NodePos poi) const;
+
+  const Graph& g;
+  size_t maxLabels;
+  Dijkstra exact;
+  std::vector<std::vector<Entry>> buckets;
+  // Lower bounds of the truncated POIs
+  std::vector<std::vector<Entry>> bounds;
+  // Nodes with bucket entries of each POI
+  std::unordered_map<NodePos, std::vector<NodePos>> pois;
+  size_t entryCount = 0;
+  size_t dropped = 0;
+  std::unordered_set<NodePos> truncated;
+  size_t exactCount = 0;
+
+  std::vector<double> costs;
+  std::vector<NodePos> touched;
+};
+
+} // namespace MULTI_CH_DIM_NAMESPACE
+
+#endif /* POIINDEX_H */
@@ -0,0 +1,35 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+// The relaxation loops of the dijkstras prefetch the costs of all edge targets before relaxing
+// them if the project is configured with -DPREFETCH=ON.
+#ifdef MULTI_CH_PREFETCH
+constexpr bool prefetching = true;
+#else
+constexpr bool prefetching = false;
+#endif
+
+template <class T> inline void prefetch(const T* address)
+{
+  // Read access with little temporal locality
+  __builtin_prefetch(address, 0, 1);
+}
+
+#endif /* PREFETCH_H */
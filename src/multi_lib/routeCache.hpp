@@ -0,0 +1,194 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef ROUTECACHE_H
+#define ROUTECACHE_H
+
+#include "sweep.hpp"
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+// Least recently used cache of query results, shared by all query threads. Routes are keyed by
+// their end points and the config rounded to percent, so configs differing by tiny amounts share
+// an entry. The result of a config sweep is stored for the whole simplex: its regions prove for
+// which configs a route is optimal, so they answer any config exactly.
+class RouteCache {
+  public:
+  RouteCache(size_t capacity)
+      : capacity(capacity)
+  {
+  }
+  RouteCache(const RouteCache& other) = delete;
+  RouteCache(RouteCache&& other) = delete;
+  virtual ~RouteCache() noexcept = default;
+  RouteCache& operator=(const RouteCache& other) = delete;
+  RouteCache& operator=(RouteCache&& other) = delete;
+
+  // Answers from the cache if possible and queries d otherwise
+  std::optional<Route> findBestRoute(Dijkstra& d, NodePos from, NodePos to, const Config& c)
+  {
+    if (auto cached = find(from, to, c)) {
+      return *cached;
+    }
+    auto route = d.findBestRoute(from, to, c);
+    insert(from, to, c, route);
+    return route;
+  }
+
+  // Returns an empty optional on a miss and an empty route if there is no route
+  std::optional<std::optional<Route>> find(NodePos from, NodePos to, const Config& c)
+  {
+    std::lock_guard guard(key);
+    if (auto entry = lookup(Key { from, to, quantize(c) })) {
+      ++hitCount;
+      return entry->empty() ? std::optional<Route> {} : entry->front().route;
+    }
+    if (auto entry = lookup(Key { from, to, wholeSimplex() })) {
+      for (const auto& r : *entry) {
+        if (std::all_of(r.region.begin(), r.region.end(),
+                [&c](const Cost& h) { return dot(h, c) >= -COST_ACCURACY; })) {
+          ++regionHitCount;
+          return r.route;
+        }
+      }
+    }
+    ++missCount;
+    return {};
+  }
+
+  void insert(NodePos from, NodePos to, const Config& c, const std::optional<Route>& route)
+  {
+    std::vector<SweepRoute> value;
+    if (route) {
+      value.push_back(SweepRoute { *route, {}, c });
+    }
+    std::lock_guard guard(key);
+    store(Key { from, to, quantize(c) }, std::move(value));
+  }
+
+  // Stores the result of ConfigSweep::findAllRoutes. Regions of an incomplete sweep do not prove
+  // optimality, so they are not stored and false is returned.
+  bool insertRegions(NodePos from, NodePos to, SweepResult sweep)
+  {
+    if (!sweep.complete) {
+      return false;
+    }
+    std::lock_guard guard(key);
+    store(Key { from, to, wholeSimplex() }, std::move(sweep.routes));
+    return true;
+  }
+
+  size_t hits() const { return hitCount; }
+  size_t regionHits() const { return regionHitCount; }
+  size_t misses() const { return missCount; }
+  double hitRate() const
+  {
+    size_t all = hitCount + regionHitCount + missCount;
+    return all == 0 ? 0 : static_cast<double>(hitCount + regionHitCount) / all;
+  }
+
+  protected:
+  private:
+  using Quantized = std::array<short, Cost::dim>;
+  struct Key {
+    NodePos from;
+    NodePos to;
+    Quantized config;
+    bool operator==(const Key& other) const
+    {
+      return from == other.from && to == other.to && config == other.config;
+    }
+  };
+  struct KeyHash {
+    size_t operator()(const Key& k) const
+    {
+      size_t hash = std::hash<NodePos>()(k.from) * 31 + std::hash<NodePos>()(k.to);
+      for (auto value : k.config) {
+        hash = hash * 31 + std::hash<short>()(value);
+      }
+      return hash;
+    }
+  };
+  using Entries = std::list<std::pair<Key, std::vector<SweepRoute>>>;
+
+  // Config::integerValues clamps to 1 like every config, so round here
+  static Quantized quantize(const Config& c)
+  {
+    Quantized result;
+    for (size_t i = 0; i < Cost::dim; ++i) {
+      result[i] = static_cast<short>(std::round(c.values[i] * 100));
+    }
+    return result;
+  }
+
+  static Quantized wholeSimplex()
+  {
+    Quantized result;
+    result.fill(-1);
+    return result;
+  }
+
+  static double dot(const Cost& h, const Config& c)
+  {
+    double sum = 0;
+    for (size_t i = 0; i < Cost::dim; ++i) {
+      sum += h.values[i] * c.values[i];
+    }
+    return sum;
+  }
+
+  const std::vector<SweepRoute>* lookup(const Key& k)
+  {
+    auto entry = index.find(k);
+    if (entry == index.end()) {
+      return nullptr;
+    }
+    entries.splice(entries.begin(), entries, entry->second);
+    return &entry->second->second;
+  }
+
+  void store(const Key& k, std::vector<SweepRoute>&& value)
+  {
+    auto entry = index.find(k);
+    if (entry != index.end()) {
+      entries.erase(entry->second);
+      index.erase(entry);
+    }
+    entries.emplace_front(k, std::move(value));
+    index.emplace(k, entries.begin());
+    while (entries.size() > capacity) {
+      index.erase(entries.back().first);
+      entries.pop_back();
+    }
+  }
+
+  size_t capacity;
+  std::mutex key {};
+  Entries entries {};
+  std::unordered_map<Key, Entries::iterator, KeyHash> index {};
+  std::atomic<size_t> hitCount = 0;
+  std::atomic<size_t> regionHitCount = 0;
+  std::atomic<size_t> missCount = 0;
+};
+
+} // namespace MULTI_CH_DIM_NAMESPACE
+
+#endif /* ROUTECACHE_H */
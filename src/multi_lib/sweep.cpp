@@ -0,0 +1,147 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include "sweep.hpp"
+#include "costEnvelope.hpp"
+#include <algorithm>
+#include <cmath>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+namespace {
+double tolerance(double cost) { return COST_ACCURACY * std::max(1.0, std::abs(cost)); }
+
+double costAt(const Cost& cost, const std::vector<double>& config)
+{
+  double sum = 0;
+  for (size_t i = 0; i < Cost::dim; ++i) {
+    sum += cost.values[i] * config[i];
+  }
+  return sum;
+}
+}
+
+ConfigSweep::ConfigSweep(Dijkstra& d, size_t maxQueries)
+    : d(d)
+    , maxQueries(maxQueries)
+{
+}
+
+bool ConfigSweep::addRoute(std::vector<Route>& routes, std::optional<Route>&& route) const
+{
+  if (!route) {
+    return false;
+  }
+  if (std::any_of(routes.begin(), routes.end(),
+          [&route](const Route& known) { return known.costs == route->costs; })) {
+    return false;
+  }
+  routes.push_back(std::move(*route));
+  return true;
+}
+
+SweepResult ConfigSweep::findAllRoutes(NodePos from, NodePos to)
+{
+  queryCount = 0;
+  std::vector<Route> routes;
+  for (size_t i = 0; i < Cost::dim; ++i) {
+    std::vector<double> values(Cost::dim, 0);
+    values[i] = 1;
+    ++queryCount;
+    addRoute(routes, d.findBestRoute(from, to, Config { values }));
+  }
+  if (routes.empty()) {
+    return {};
+  }
+
+  // Route costs are not negative, so -1 is below all of them
+  double highest = 0;
+  for (const auto& r : routes) {
+    highest = std::max(highest, *std::max_element(r.costs.values.begin(), r.costs.values.end()));
+  }
+  CostEnvelope bound { -1, highest + 1 };
+  for (const auto& r : routes) {
+    bound.add(r.costs.values);
+  }
+
+  std::vector<CostEnvelope::Vertex> confirmed;
+  auto isConfirmed = [&confirmed](const CostEnvelope::Vertex& v) {
+    return std::any_of(confirmed.begin(), confirmed.end(), [&v](const auto& other) {
+      for (size_t i = 0; i < Cost::dim; ++i) {
+        if (std::abs(other.config[i] - v.config[i]) > 1e-9) {
+          return false;
+        }
+      }
+      return true;
+    });
+  };
+
+  bool complete = false;
+  std::vector<CostEnvelope::Vertex> vertices = bound.vertices();
+  while (true) {
+    auto open = std::find_if_not(vertices.begin(), vertices.end(), isConfirmed);
+    if (open == vertices.end()) {
+      complete = true;
+      break;
+    }
+    if (queryCount >= maxQueries) {
+      break;
+    }
+    ++queryCount;
+    auto route = d.findBestRoute(from, to, Config { open->config });
+    if (route && costAt(route->costs, open->config) < open->cost - tolerance(open->cost)) {
+      auto costs = route->costs;
+      if (addRoute(routes, std::move(route))) {
+        bound.add(costs.values);
+        vertices = bound.vertices();
+        continue;
+      }
+    }
+    confirmed.push_back(*open);
+  }
+
+  std::vector<SweepRoute> result;
+  for (auto& r : routes) {
+    std::vector<double> center(Cost::dim, 0);
+    size_t active = 0;
+    for (const auto& v : vertices) {
+      if (std::abs(costAt(r.costs, v.config) - v.cost) <= tolerance(v.cost)) {
+        for (size_t i = 0; i < Cost::dim; ++i) {
+          center[i] += v.config[i];
+        }
+        ++active;
+      }
+    }
+    // Routes which are not optimal at any vertex are beaten everywhere
+    if (active == 0) {
+      continue;
+    }
+    for (auto& value : center) {
+      value /= active;
+    }
+    std::vector<Cost> region;
+    for (const auto& other : routes) {
+      if (&other != &r) {
+        region.push_back(other.costs - r.costs);
+      }
+    }
+    result.push_back(SweepRoute { std::move(r), std::move(region), Config { center } });
+  }
+  return SweepResult { std::move(result), complete };
+}
+
+} // namespace MULTI_CH_DIM_NAMESPACE
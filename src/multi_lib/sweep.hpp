@@ -0,0 +1,68 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include "dijkstra.hpp"
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+struct SweepRoute {
+  Route route;
+  // The route is optimal for all configs c with h * c >= 0 for every half space h
+  std::vector<Cost> region;
+  // A config inside of the region
+  Config config;
+};
+
+struct SweepResult {
+  std::vector<SweepRoute> routes;
+  // False if the query limit was hit first, the routes are then optimal for their configs but
+  // routes may be missing and the regions are no proof of optimality
+  bool complete = true;
+};
+
+// Finds every route between two nodes which is optimal for some config. The known routes
+// define an upper bound of the cost of the best route over the config simplex. Every vertex of
+// this bound is checked with a query. A cheaper route found at a vertex cuts it off, otherwise
+// the bound is exact there. When all vertices are confirmed no route is missing.
+class ConfigSweep {
+  public:
+  ConfigSweep(Dijkstra& d, size_t maxQueries = 1000);
+  ConfigSweep(const ConfigSweep& other) = delete;
+  ConfigSweep(ConfigSweep&& other) = delete;
+  virtual ~ConfigSweep() noexcept = default;
+  ConfigSweep& operator=(const ConfigSweep& other) = delete;
+  ConfigSweep& operator=(ConfigSweep&& other) = delete;
+
+  SweepResult findAllRoutes(NodePos from, NodePos to);
+
+  // Number of queries of the last sweep
+  size_t queries() const { return queryCount; }
+
+  private:
+  bool addRoute(std::vector<Route>& routes, std::optional<Route>&& route) const;
+
+  Dijkstra& d;
+  size_t maxQueries;
+  size_t queryCount = 0;
+};
+
+} // namespace MULTI_CH_DIM_NAMESPACE
+
+#endif /* SWEEP_H */
@@ -0,0 +1,127 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef WITNESSCACHE_H
+#define WITNESSCACHE_H
+
+#include "graph.hpp"
+#include <array>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+// Costs of witness paths found while contracting, keyed by the (source, target) node ids of the
+// pair. Contraction keeps the distances between the remaining nodes for every config, so a
+// witness found in an earlier round is an upper bound of the current distance even if the path
+// itself does not exist any more.
+class WitnessCache {
+  public:
+  WitnessCache() = default;
+  WitnessCache(const WitnessCache& other) = delete;
+  WitnessCache(WitnessCache&& other) = delete;
+  virtual ~WitnessCache() noexcept = default;
+  WitnessCache& operator=(const WitnessCache& other) = delete;
+  WitnessCache& operator=(WitnessCache&& other) = delete;
+
+  void insert(NodeId source, NodeId target, const Cost& cost)
+  {
+    Key k { source, target };
+    auto& shard = shardOf(k);
+    std::lock_guard guard(shard.key);
+    auto& costs = shard.witnesses[k];
+    if (std::find(costs.begin(), costs.end(), cost) != costs.end()) {
+      return;
+    }
+    if (costs.size() >= maxWitnesses) {
+      costs.erase(costs.begin());
+    }
+    costs.push_back(cost);
+  }
+
+  // Appends the cached witness costs from source to target to result
+  void find(NodeId source, NodeId target, std::vector<Cost>& result)
+  {
+    Key k { source, target };
+    auto& shard = shardOf(k);
+    std::lock_guard guard(shard.key);
+    auto entry = shard.witnesses.find(k);
+    if (entry != shard.witnesses.end()) {
+      result.insert(result.end(), entry->second.begin(), entry->second.end());
+    }
+  }
+
+  // Drops all entries starting or ending at contracted nodes
+  void invalidate(const std::unordered_set<NodeId>& contracted)
+  {
+    for (auto& shard : shards) {
+      std::lock_guard guard(shard.key);
+      for (auto entry = shard.witnesses.begin(); entry != shard.witnesses.end();) {
+        if (contracted.count(entry->first.source) > 0
+            || contracted.count(entry->first.target) > 0) {
+          entry = shard.witnesses.erase(entry);
+        } else {
+          ++entry;
+        }
+      }
+    }
+  }
+
+  size_t memoryUsage()
+  {
+    size_t bytes = 0;
+    for (auto& shard : shards) {
+      std::lock_guard guard(shard.key);
+      bytes += shard.witnesses.bucket_count() * sizeof(void*);
+      for (const auto& entry : shard.witnesses) {
+        bytes += sizeof(entry) + entry.second.capacity() * sizeof(Cost);
+      }
+    }
+    return bytes;
+  }
+
+  protected:
+  private:
+  struct Key {
+    NodeId source;
+    NodeId target;
+    bool operator==(const Key& other) const
+    {
+      return source == other.source && target == other.target;
+    }
+  };
+  struct KeyHash {
+    size_t operator()(const Key& k) const
+    {
+      return std::hash<NodeId>()(k.source) * 31 + std::hash<NodeId>()(k.target);
+    }
+  };
+  struct Shard {
+    std::mutex key {};
+    std::unordered_map<Key, std::vector<Cost>, KeyHash> witnesses {};
+  };
+
+  Shard& shardOf(const Key& k) { return shards[KeyHash()(k) % shards.size()]; }
+
+  static constexpr size_t maxWitnesses = 8;
+  std::array<Shard, 64> shards {};
+};
+
+} // namespace MULTI_CH_DIM_NAMESPACE
+
+#endif /* WITNESSCACHE_H */
@@ -0,0 +1,252 @@
+/*
+  Cycle-routing does multi-criteria route planning for bicycles.
+  Copyright (C) 2018  Florian Barth
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef WITNESSTRACE_H
+#define WITNESSTRACE_H
+
+#include "graph.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <unistd.h>
+
+inline namespace MULTI_CH_DIM_NAMESPACE {
+
+struct TracedHalfEdge {
+  uint64_t id;
+  uint64_t begin;
+  uint64_t end;
+  Cost cost;
+};
+
+struct WitnessSearch {
+  uint64_t snapshot;
+  TracedHalfEdge in;
+  TracedHalfEdge out;
+  std::array<double, Cost::dim> config;
+  bool found = false;
+  // Cost of the witness if one was found
+  Cost witness;
+};
+
+// Outgoing edges of the graph a witness search ran on, sorted by their begin
+struct GraphSnapshot {
+  uint64_t nodeCount = 0;
+  std::vector<TracedHalfEdge> edges;
+};
+
+// Records a sample of the witness searches run while contracting for bench_witness. The trace
+// starts with a magic and the dimension, followed by fixed size WitnessSearch records. Only the
+// searches of the chosen rounds are sampled. The graph of such a round is saved next to the
+// trace as <trace>.<snapshot> before its searches start. Snapshot ids contain the process id, so
+// forked partition workers can share the trace.
+class WitnessTrace {
+  public:
+  // Rounds are counted from 1
+  static void record(const std::string& fileName, double sampleRate, std::set<size_t> rounds)
+  {
+    std::lock_guard guard(key);
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+    rate = sampleRate;
+    traceFileName = fileName;
+    recordedRounds = std::move(rounds);
+    round = 0;
+    tracing = false;
+    if (fileName.empty()) {
+      return;
+    }
+    fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+      throw std::runtime_error("Could not open " + fileName + ": " + std::strerror(errno));
+    }
+    std::string header { magic, sizeof(magic) };
+    append(header, static_cast<uint64_t>(Cost::dim));
+    writeRecord(header);
+  }
+
+  static bool recording() { return fd >= 0; }
+
+  // Decides if the next search is part of the sample
+  static bool sample()
+  {
+    // Forked partition workers inherit the generator of their parent, so every process seeds
+    // its own
+    thread_local pid_t seeded = 0;
+    thread_local std::mt19937 random {};
+    if (seeded != getpid()) {
+      seeded = getpid();
+      random.seed(std::random_device {}() ^ static_cast<std::mt19937::result_type>(seeded));
+    }
+    return tracing && std::uniform_real_distribution<double>(0, 1)(random) < rate;
+  }
+
+  // The searches until the next call run on g, which has to stay unchanged until then. Has to be
+  // called before the searches of the round start, the snapshot is written without blocking them.
+  static void beginRound(const Graph& g)
+  {
+    uint64_t snapshot = 0;
+    {
+      std::lock_guard guard(key);
+      ++round;
+      tracing = false;
+      if (recordedRounds.count(round) == 0) {
+        return;
+      }
+      snapshot = snapshotId();
+    }
+    saveSnapshot(g, snapshotFileName(traceFileName, snapshot));
+    tracing = true;
+  }
+
+  static void add(
+      const HalfEdge& in, const HalfEdge& out, const Config& config, const Cost* witness)
+  {
+    WitnessSearch search {};
+    search.in = traced(in);
+    search.out = traced(out);
+    for (size_t i = 0; i < Cost::dim; ++i) {
+      search.config[i] = config.values[i];
+    }
+    search.found = witness != nullptr;
+    if (witness) {
+      search.witness = *witness;
+    }
+    std::lock_guard guard(key);
+    if (!tracing) {
+      return;
+    }
+    search.snapshot = snapshotId();
+    std::string record;
+    append(record, search);
+    writeRecord(record);
+  }
+
+  static std::string snapshotFileName(const std::string& traceFileName, uint64_t snapshot)
+  {
+    return traceFileName + "." + std::to_string(snapshot);
+  }
+
+  static std::vector<WitnessSearch> read(const std::string& fileName)
+  {
+    std::ifstream in { fileName, std::ios::binary };
+    readHeader(in, fileName, magic, "witness trace");
+    std::vector<WitnessSearch> searches;
+    WitnessSearch search;
+    while (in.read(reinterpret_cast<char*>(&search), sizeof(search))) {
+      searches.push_back(search);
+    }
+    if (in.gcount() != 0) {
+      throw std::invalid_argument(fileName + " ends in the middle of a search");
+    }
+    return searches;
+  }
+
+  static GraphSnapshot readSnapshot(const std::string& fileName)
+  {
+    std::ifstream in { fileName, std::ios::binary };
+    readHeader(in, fileName, snapshotMagic, "graph snapshot");
+    GraphSnapshot snapshot;
+    uint64_t edgeCount = 0;
+    in.read(reinterpret_cast<char*>(&snapshot.nodeCount), sizeof(snapshot.nodeCount));
+    in.read(reinterpret_cast<char*>(&edgeCount), sizeof(edgeCount));
+    snapshot.edges.resize(edgeCount);
+    in.read(reinterpret_cast<char*>(snapshot.edges.data()),
+        static_cast<std::streamsize>(edgeCount * sizeof(TracedHalfEdge)));
+    if (!in) {
+      throw std::invalid_argument(fileName + " ends in the middle of the graph");
+    }
+    return snapshot;
+  }
+
+  private:
+  static uint64_t snapshotId() { return (static_cast<uint64_t>(getpid()) << 32) | round; }
+
+  static TracedHalfEdge traced(const HalfEdge& e)
+  {
+    return TracedHalfEdge { e.id.get(), e.begin.get(), e.end.get(), e.cost };
+  }
+
+  template <class T> static void append(std::string& buffer, const T& value)
+  {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+
+  static void readHeader(
+      std::ifstream& in, const std::string& fileName, const char* expected, const char* kind)
+  {
+    char fileMagic[sizeof(magic)];
+    uint64_t dim = 0;
+    in.read(fileMagic, sizeof(fileMagic));
+    in.read(reinterpret_cast<char*>(&dim), sizeof(dim));
+    if (!in || std::memcmp(fileMagic, expected, sizeof(magic)) != 0 || dim != Cost::dim) {
+      throw std::invalid_argument(fileName + " is not a " + kind + " of dimension "
+          + std::to_string(Cost::dim));
+    }
+  }
+
+  static void saveSnapshot(const Graph& g, const std::string& fileName)
+  {
+    std::ofstream out { fileName, std::ios::binary };
+    std::string header { snapshotMagic, sizeof(snapshotMagic) };
+    append(header, static_cast<uint64_t>(Cost::dim));
+    append(header, static_cast<uint64_t>(g.getNodeCount()));
+    append(header, static_cast<uint64_t>(g.getEdgeCount()));
+    out.write(header.data(), static_cast<std::streamsize>(header.size()));
+    std::vector<TracedHalfEdge> edges;
+    for (size_t i = 0; i < g.getNodeCount(); ++i) {
+      edges.clear();
+      for (const auto& edge : g.getOutgoingEdgesOf(NodePos { i })) {
+        edges.push_back(traced(edge));
+      }
+      out.write(reinterpret_cast<const char*>(edges.data()),
+          static_cast<std::streamsize>(edges.size() * sizeof(TracedHalfEdge)));
+    }
+    if (!out) {
+      std::cerr << "Could not write graph snapshot " << fileName << '\n';
+    }
+  }
+
+  static void writeRecord(const std::string& record)
+  {
+    if (fd >= 0 && write(fd, record.data(), record.size()) != static_cast<ssize_t>(record.size())) {
+      std::cerr << "Could not write witness trace: " << std::strerror(errno) << '\n';
+    }
+  }
+
+  static constexpr char magic[8] = "MCHWIT1";
+  static constexpr char snapshotMagic[8] = "MCHSNP1";
+  static inline std::mutex key {};
+  static inline int fd = -1;
+  static inline double rate = 0;
+  static inline std::string traceFileName {};
+  static inline std::set<size_t> recordedRounds {};
+  static inline uint64_t round = 0;
+  static inline std::atomic<bool> tracing = false;
+};
+
+} // namespace MULTI_CH_DIM_NAMESPACE
+
+#endif /* WITNESSTRACE_H */
@@ -0,0 +1,113 @@
+#include "contractor.hpp"
+#include "graph.hpp"
+#include "grid_graph.hpp"
+#include "partition.hpp"
+
+#include "catch.hpp"
+
+#include <random>
+#include <set>
+#include <tuple>
+
+namespace {
+using Shortcut = std::tuple<size_t, size_t, std::vector<double>>;
+
+// Source, destination and cost of the shortcuts of the last contracted graph
+std::set<Shortcut> shortcuts()
+{
+  std::set<Shortcut> result;
+  for (const auto& e : Edge::edges) {
+    if (e.getEdgeA()) {
+      const auto& cost = e.getCost();
+      result.emplace(e.getSourceId(), e.getDestId(),
+          std::vector<double>(cost.values.begin(), cost.values.end()));
+    }
+  }
+  return result;
+}
+
+// Compares the queries on the grid contracted by c with a deterministic contraction
+template <class C> void checkContraction(C& c, std::mt19937::result_type seed)
+{
+  const size_t side = 10;
+  std::mt19937 random { seed };
+  auto edges = gridEdges(side, random);
+  auto reference = contractGrid(side, edges);
+  auto expected = queryCosts(reference, side * side);
+
+  auto g = loadGrid(side, edges);
+  auto contracted = c.contractCompletely(g, 0);
+  auto costs = queryCosts(contracted, side * side);
+  REQUIRE(costs.size() == expected.size());
+  for (size_t i = 0; i < costs.size(); ++i) {
+    REQUIRE(costs[i] == Approx(expected[i]));
+  }
+}
+}
+
+TEST_CASE("Deterministic contraction creates the same shortcuts with any number of threads")
+{
+  const size_t side = 10;
+  std::mt19937 random { 5 };
+  auto edges = gridEdges(side, random);
+
+  auto sequential = contractGrid(side, edges, 1);
+  auto expected = shortcuts();
+  auto parallel = contractGrid(side, edges, 3);
+
+  REQUIRE(!expected.empty());
+  REQUIRE(shortcuts() == expected);
+  for (size_t i = 0; i < side * side; ++i) {
+    REQUIRE(parallel.getLevelOf(*parallel.nodePosById(NodeId { i }))
+        == sequential.getLevelOf(*sequential.nodePosById(NodeId { i })));
+  }
+}
+
+TEST_CASE("Edge pairs over their budget get shortcuts and keep the queries exact")
+{
+  const size_t side = 10;
+  std::mt19937 random { 7 };
+  auto edges = gridEdges(side, random);
+
+  auto unlimited = contractGrid(side, edges);
+  auto expected = queryCosts(unlimited, side * side);
+  auto shortcutCount = shortcuts().size();
+
+  PairBudget lpCalls {};
+  lpCalls.lpCalls = 1;
+  PairBudget constraints {};
+  constraints.constraints = 1;
+  for (const auto& budget : { lpCalls, constraints }) {
+    auto limited = contractGrid(side, edges, 1, budget);
+    REQUIRE(shortcuts().size() >= shortcutCount);
+
+    auto costs = queryCosts(limited, side * side);
+    REQUIRE(costs.size() == expected.size());
+    for (size_t i = 0; i < costs.size(); ++i) {
+      REQUIRE(costs[i] == Approx(expected[i]));
+    }
+  }
+}
+
+TEST_CASE("Contraction with the witness cache keeps the queries exact")
+{
+  // The cache is only used without deterministic mode
+  Contractor c { false, 2 };
+  c.setWitnessCache(true);
+  checkContraction(c, 9);
+}
+
+TEST_CASE("Asynchronous contraction keeps the queries exact")
+{
+  Contractor c { false, 3 };
+  c.setAsync(true);
+  checkContraction(c, 10);
+}
+
+TEST_CASE("Partitioned contraction keeps the queries exact")
+{
+  for (size_t cells : { 2, 3, 4 }) {
+    PartitionContractor c { cells, false, 2 };
+    checkContraction(c, 11 + cells);
+  }
+}
@@ -0,0 +1,102 @@
+#ifndef GRID_GRAPH_H
+#define GRID_GRAPH_H
+
+#include "contractor.hpp"
+#include "dijkstra.hpp"
+#include "graph.hpp"
+
+#include <random>
+#include <sstream>
+#include <vector>
+
+struct BaseEdge {
+  size_t source;
+  size_t dest;
+  Cost cost;
+};
+
+// Grid of side x side nodes with edges in both directions between neighbours
+inline std::vector<BaseEdge> gridEdges(size_t side, std::mt19937& random)
+{
+  std::uniform_real_distribution<double> dist(1, 10);
+  std::vector<BaseEdge> edges;
+  for (size_t i = 0; i < side * side; ++i) {
+    for (auto next : { i + 1, i + side }) {
+      if ((next == i + 1 && next % side == 0) || next >= side * side) {
+        continue;
+      }
+      edges.push_back(BaseEdge { i, next, Cost { std::vector { dist(random), dist(random) } } });
+      edges.push_back(BaseEdge { next, i, Cost { std::vector { dist(random), dist(random) } } });
+    }
+  }
+  return edges;
+}
+
+// Edge::edges holds the edges of one graph only, so the edges of the last graph are dropped. The
+// nodes lie on a grid of coordinates 0.001 degrees apart.
+inline Graph loadGrid(size_t side, const std::vector<BaseEdge>& edges)
+{
+  Edge::edges = std::vector<Edge>();
+  Edge::regions.clear();
+  std::stringstream text;
+  // Changed costs are compared with full precision
+  text.precision(17);
+  text << "# Grid" << '\n' << '\n' << Cost::dim << '\n' << side * side << '\n';
+  text << edges.size() << '\n';
+  for (size_t i = 0; i < side * side; ++i) {
+    text << i << ' ' << i << ' ' << 48.1 + 0.001 * (i / side) << ' ' << 9.2 + 0.001 * (i % side)
+         << " 0 0" << '\n';
+  }
+  for (const auto& e : edges) {
+    text << e.source << ' ' << e.dest << ' ' << e.cost.values[0] << ' ' << e.cost.values[1]
+         << " -1 -1" << '\n';
+  }
+  return Graph::createFromStream(text);
+}
+
+inline Graph contractGrid(size_t side, const std::vector<BaseEdge>& edges, size_t threads = 1,
+    const PairBudget& budget = {}, bool configRegions = false)
+{
+  auto g = loadGrid(side, edges);
+  Contractor c { false, threads };
+  c.setDeterministic(true);
+  c.setPairBudget(budget);
+  c.setConfigRegions(configRegions);
+  return c.contractCompletely(g, 0);
+}
+
+inline Config randomConfig(std::mt19937& random)
+{
+  std::uniform_real_distribution<double> dist(0, 1);
+  std::vector<double> values(Cost::dim);
+  double sum = 0;
+  for (auto& value : values) {
+    value = dist(random);
+    sum += value;
+  }
+  for (auto& value : values) {
+    value /= sum;
+  }
+  return Config { values };
+}
+
+// Costs of the queries between some nodes of the grid for a few configs, -1 if there is no route
+inline std::vector<double> queryCosts(Graph& g, size_t nodeCount)
+{
+  auto d = g.createDijkstra();
+  std::vector<Config> configs { Config { { 1.0, 0.0 } }, Config { { 0.0, 1.0 } },
+    Config { { 0.5, 0.5 } }, Config { { 0.2, 0.8 } } };
+  std::vector<double> costs;
+  for (size_t from = 0; from < nodeCount; from += 3) {
+    for (size_t to = 0; to < nodeCount; to += 5) {
+      for (const auto& config : configs) {
+        auto route = d.findBestRoute(
+            *g.nodePosById(NodeId { from }), *g.nodePosById(NodeId { to }), config);
+        costs.push_back(route ? route->costs * config : -1);
+      }
+    }
+  }
+  return costs;
+}
+
+#endif /* GRID_GRAPH_H */
@@ -0,0 +1,69 @@
+#include "graph.hpp"
+#include "grid_graph.hpp"
+#include "metricUpdate.hpp"
+
+#include "catch.hpp"
+
+#include <boost/filesystem.hpp>
+#include <random>
+
+namespace {
+// Changes one cost of a share of the edges by the factor
+std::vector<CostChange> changeCosts(
+    std::vector<BaseEdge>& edges, std::mt19937& random, double share, double factor)
+{
+  std::bernoulli_distribution changed(share);
+  std::vector<CostChange> changes;
+  for (size_t i = 0; i < edges.size(); ++i) {
+    if (changed(random)) {
+      edges[i].cost.values[i % Cost::dim] *= factor;
+      changes.push_back(CostChange { EdgeId { i }, edges[i].cost });
+    }
+  }
+  return changes;
+}
+
+// Compares the queries on a contracted grid updated twice with changed costs with the queries on
+// the grid contracted with these costs from the start. The second update reads the witnesses of
+// the first one.
+void checkUpdate(std::mt19937::result_type seed, double factor)
+{
+  const size_t side = 10;
+  std::mt19937 random { seed };
+  auto edges = gridEdges(side, random);
+  auto changedEdges = edges;
+  auto firstChanges = changeCosts(changedEdges, random, 0.1, factor);
+  auto secondChanges = changeCosts(changedEdges, random, 0.02, factor);
+  auto contracted = contractGrid(side, changedEdges);
+  auto expected = queryCosts(contracted, side * side);
+
+  // The base edges get the first ids, in the order of the graph file
+  auto updated = contractGrid(side, edges);
+  auto fileName = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  size_t firstPairs = 0;
+  {
+    MetricUpdate update { updated, 1 };
+    update.update(firstChanges);
+    update.writeWitnesses(fileName.string());
+    firstPairs = update.checkedPairs();
+  }
+  MetricUpdate update { updated, 1 };
+  update.readWitnesses(fileName.string());
+  boost::filesystem::remove(fileName);
+  update.update(secondChanges);
+  auto costs = queryCosts(updated, side * side);
+
+  // Only the first increase checks every pair
+  if (factor > 1) {
+    REQUIRE(update.checkedPairs() < firstPairs);
+  }
+  REQUIRE(costs.size() == expected.size());
+  for (size_t i = 0; i < costs.size(); ++i) {
+    REQUIRE(costs[i] == Approx(expected[i]));
+  }
+}
+}
+
+TEST_CASE("Metric update with cost increases matches contracting again") { checkUpdate(1, 3); }
+
+TEST_CASE("Metric update with cost decreases matches contracting again") { checkUpdate(3, 0.1); }
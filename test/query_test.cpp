@@ -0,0 +1,315 @@
+#include "dijkstra.hpp"
+#include "graph.hpp"
+#include "grid.hpp"
+#include "grid_graph.hpp"
+#include "mappedGraph.hpp"
+#include "poiIndex.hpp"
+#include "routeCache.hpp"
+#include "sweep.hpp"
+
+#include "catch.hpp"
+
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+namespace {
+const size_t side = 10;
+
+// Number of POIs dropped from the labels
+size_t checkPois(size_t maxLabels)
+{
+  std::mt19937 random { 11 };
+  auto g = contractGrid(side, gridEdges(side, random));
+  Dijkstra d = g.createDijkstra();
+  PoiIndex index { g, maxLabels };
+
+  std::vector<NodePos> nodes;
+  for (size_t i = 0; i < g.getNodeCount(); ++i) {
+    nodes.emplace_back(i);
+  }
+  std::shuffle(nodes.begin(), nodes.end(), random);
+  const size_t count = 16;
+  std::vector<NodePos> pois(nodes.begin(), nodes.begin() + count);
+  for (auto poi : pois) {
+    index.add(poi);
+  }
+
+  std::uniform_int_distribution<size_t> dist(0, g.getNodeCount() - 1);
+  const size_t k = 3;
+  for (int i = 0; i < 40; ++i) {
+    if (i == 20) {
+      for (size_t j = 0; j < count / 2; ++j) {
+        index.remove(pois[j]);
+        pois[j] = nodes[count + j];
+        index.add(pois[j]);
+      }
+    }
+    NodePos from { dist(random) };
+    auto c = randomConfig(random);
+    auto nearest = index.findNearest(from, c, k);
+
+    std::vector<double> expected;
+    for (auto poi : pois) {
+      if (auto route = d.findBestRoute(from, poi, c)) {
+        expected.push_back(route->costs * c);
+      }
+    }
+    std::sort(expected.begin(), expected.end());
+    expected.resize(std::min(expected.size(), k));
+    REQUIRE(nearest.size() == expected.size());
+    for (size_t j = 0; j < expected.size(); ++j) {
+      REQUIRE(nearest[j].second == Approx(expected[j]));
+    }
+  }
+  // Truncated POIs are only queried when they can be among the nearest ones
+  if (index.exactPois() > 0) {
+    REQUIRE(index.exactQueries() < 40 * index.exactPois());
+  }
+  return index.droppedLabels();
+}
+}
+
+TEST_CASE("Config sweeps find the best route for every config")
+{
+  std::mt19937 random { 1 };
+  auto g = contractGrid(side, gridEdges(side, random));
+  Dijkstra d = g.createDijkstra();
+  Dijkstra check = g.createDijkstra();
+  ConfigSweep sweep { d };
+  std::uniform_int_distribution<size_t> dist(0, g.getNodeCount() - 1);
+
+  for (int i = 0; i < 20; ++i) {
+    NodePos from { dist(random) };
+    NodePos to { dist(random) };
+    auto result = sweep.findAllRoutes(from, to);
+    const auto& found = result.routes;
+    REQUIRE(result.complete);
+    REQUIRE(!found.empty());
+
+    for (int j = 0; j < 20; ++j) {
+      auto c = randomConfig(random);
+      auto best = check.findBestRoute(from, to, c);
+      auto cheapest = std::min_element(found.begin(), found.end(),
+          [&c](const auto& a, const auto& b) { return a.route.costs * c < b.route.costs * c; });
+      REQUIRE(cheapest->route.costs * c == Approx(best->costs * c));
+    }
+  }
+}
+
+TEST_CASE("Alternative routes start with the best route and have bounded stretch")
+{
+  std::mt19937 random { 2 };
+  auto g = contractGrid(side, gridEdges(side, random));
+  Dijkstra d = g.createDijkstra();
+  std::uniform_int_distribution<size_t> dist(0, g.getNodeCount() - 1);
+
+  for (int i = 0; i < 50; ++i) {
+    NodePos from { dist(random) };
+    NodePos to { dist(random) };
+    auto c = randomConfig(random);
+    auto best = d.findBestRoute(from, to, c);
+    auto routes = d.findAlternativeRoutes(from, to, c, 3);
+    REQUIRE(best);
+    REQUIRE(!routes.empty());
+
+    double length = best->costs * c;
+    REQUIRE(routes.front().costs * c == Approx(length));
+    for (const auto& route : routes) {
+      REQUIRE(route.costs * c <= 1.25 * length + 0.1);
+    }
+  }
+}
+
+TEST_CASE("Parallel queries find routes as cheap as sequential queries")
+{
+  std::mt19937 random { 5 };
+  auto g = contractGrid(side, gridEdges(side, random));
+  Dijkstra sequential = g.createDijkstra();
+  Dijkstra parallel = g.createDijkstra();
+  parallel.searchInParallel(true);
+  std::uniform_int_distribution<size_t> dist(0, g.getNodeCount() - 1);
+
+  for (int i = 0; i < 200; ++i) {
+    NodePos from { dist(random) };
+    NodePos to { dist(random) };
+    auto c = randomConfig(random);
+    auto expected = sequential.findBestRoute(from, to, c);
+    auto route = parallel.findBestRoute(from, to, c);
+    REQUIRE(expected);
+    REQUIRE(route);
+    REQUIRE(route->costs * c == Approx(expected->costs * c));
+  }
+}
+
+TEST_CASE("Queries pruned by config regions match the unpruned queries")
+{
+  std::mt19937 random { 3 };
+  auto g = contractGrid(side, gridEdges(side, random), 1, PairBudget {}, true);
+  auto fileName = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  MappedGraph::write(g, fileName.string());
+
+  {
+    MappedGraph mapped { fileName.string() };
+    REQUIRE(mapped.getRegionCount() > 0);
+    MappedDijkstra mappedDijkstra { mapped };
+    mappedDijkstra.pruneByConfigRegion(true);
+    Dijkstra pruned = g.createDijkstra();
+    pruned.pruneByConfigRegion(true);
+    Dijkstra d = g.createDijkstra();
+    std::uniform_int_distribution<size_t> dist(0, g.getNodeCount() - 1);
+
+    for (int i = 0; i < 200; ++i) {
+      NodePos from { dist(random) };
+      NodePos to { dist(random) };
+      auto c = randomConfig(random);
+      auto expected = d.findBestRoute(from, to, c);
+      auto route = pruned.findBestRoute(from, to, c);
+      auto mappedRoute = mappedDijkstra.findBestRoute(from, to, c);
+      REQUIRE(expected);
+      REQUIRE(route);
+      REQUIRE(mappedRoute);
+      REQUIRE(route->costs * c == Approx(expected->costs * c));
+      REQUIRE(mappedRoute->costs * c == Approx(expected->costs * c));
+    }
+  }
+  boost::filesystem::remove(fileName);
+}
+
+TEST_CASE("Truncated or corrupt query files are rejected")
+{
+  std::mt19937 random { 8 };
+  auto g = contractGrid(side, gridEdges(side, random));
+  auto fileName = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  MappedGraph::write(g, fileName.string());
+  std::string content;
+  {
+    std::ifstream in { fileName.string(), std::ios::binary };
+    content.assign(std::istreambuf_iterator<char>(in), {});
+  }
+  auto check = [&fileName](const std::string& data) {
+    {
+      std::ofstream out { fileName.string(), std::ios::binary | std::ios::trunc };
+      out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+    REQUIRE_THROWS_AS(MappedGraph { fileName.string() }, std::invalid_argument);
+  };
+  // The header holds the magic, then the dimension, the counts and the array offsets
+  auto field = [&content](size_t index) {
+    uint64_t value;
+    std::memcpy(&value, content.data() + 8 + 8 * index, sizeof(value));
+    return value;
+  };
+  auto setField = [](std::string data, size_t offset, uint64_t value) {
+    std::memcpy(&data[offset], &value, sizeof(value));
+    return data;
+  };
+
+  check(content.substr(0, content.size() / 2));
+  // Node count
+  check(setField(content, 8 + 8 * 1, uint64_t { 1 } << 60));
+  // End of the first out edge
+  check(setField(content, field(10), g.getNodeCount()));
+  // Last out offset
+  check(setField(content, field(8) + 8 * g.getNodeCount(), field(2) + 1));
+  boost::filesystem::remove(fileName);
+}
+
+TEST_CASE("Grid lookups find the nearest nodes")
+{
+  std::mt19937 random { 4 };
+  auto g = loadGrid(side, gridEdges(side, random));
+  Grid grid = g.createGrid();
+
+  std::vector<std::pair<double, double>> coordinates;
+  for (size_t i = 0; i < g.getNodeCount(); ++i) {
+    auto [lat, lng] = Grid::coordinatesOf(g, NodePos { i });
+    coordinates.emplace_back(lat, lng);
+  }
+  auto [minLat, maxLat] = std::minmax_element(coordinates.begin(), coordinates.end());
+  std::uniform_real_distribution<double> latDist(minLat->first - 0.01, maxLat->first + 0.01);
+  std::uniform_int_distribution<size_t> nodeDist(0, g.getNodeCount() - 1);
+  double scale = std::cos((minLat->first + maxLat->first) / 2 * M_PI / 180);
+
+  const size_t k = 5;
+  for (int i = 0; i < 200; ++i) {
+    double lat = latDist(random);
+    double lng = coordinates[nodeDist(random)].second;
+    auto nearest = grid.findNearestNodes(Lat { lat }, Lng { lng }, k);
+
+    auto distance = [&](NodePos pos) {
+      double dLat = coordinates[pos].first - lat;
+      double dLng = (coordinates[pos].second - lng) * scale;
+      return std::sqrt(dLat * dLat + dLng * dLng);
+    };
+    std::vector<double> expected;
+    for (size_t j = 0; j < g.getNodeCount(); ++j) {
+      expected.push_back(distance(NodePos { j }));
+    }
+    std::sort(expected.begin(), expected.end());
+    REQUIRE(nearest.size() == k);
+    for (size_t j = 0; j < k; ++j) {
+      REQUIRE(distance(nearest[j]) == Approx(expected[j]).margin(1e-12));
+    }
+  }
+}
+
+TEST_CASE("Nearest POIs match a query to every POI") { checkPois(32); }
+
+TEST_CASE("Nearest POIs with dropped labels match a query to every POI")
+{
+  REQUIRE(checkPois(1) > 0);
+}
+
+TEST_CASE("Route cache regions answer configs near the sliders exactly")
+{
+  std::mt19937 random { 6 };
+  auto g = contractGrid(side, gridEdges(side, random));
+  Dijkstra d = g.createDijkstra();
+  Dijkstra check = g.createDijkstra();
+  ConfigSweep sweep { d };
+  RouteCache cache { 64 };
+  std::uniform_int_distribution<size_t> dist(0, g.getNodeCount() - 1);
+  std::uniform_real_distribution<double> jitter(-0.002, 0.002);
+
+  // Popular pairs, the first ones are swept
+  std::vector<std::pair<NodePos, NodePos>> pairs;
+  for (int i = 0; i < 20; ++i) {
+    pairs.emplace_back(NodePos { dist(random) }, NodePos { dist(random) });
+  }
+  for (int i = 0; i < 5; ++i) {
+    const auto& [from, to] = pairs[i];
+    REQUIRE(cache.insertRegions(from, to, sweep.findAllRoutes(from, to)));
+  }
+  std::vector<Config> sliders;
+  for (int i = 0; i < 5; ++i) {
+    sliders.push_back(randomConfig(random));
+  }
+
+  std::uniform_int_distribution<size_t> pairDist(0, pairs.size() - 1);
+  std::uniform_int_distribution<size_t> sliderDist(0, sliders.size() - 1);
+  for (int i = 0; i < 500; ++i) {
+    const auto& [from, to] = pairs[pairDist(random)];
+    std::vector<double> values(Cost::dim);
+    const auto& slider = sliders[sliderDist(random)];
+    for (size_t j = 0; j < Cost::dim; ++j) {
+      values[j] = slider.values[j] + jitter(random);
+    }
+    Config c { values };
+
+    size_t regionHits = cache.regionHits();
+    auto route = cache.findBestRoute(d, from, to, c);
+    auto exact = check.findBestRoute(from, to, c);
+    REQUIRE(route);
+    REQUIRE(exact);
+    // Entries of single configs only match up to the rounding of the config, regions are exact
+    if (cache.regionHits() > regionHits) {
+      REQUIRE(route->costs * c == Approx(exact->costs * c));
+    }
+  }
+  REQUIRE(cache.regionHits() > 0);
+  REQUIRE(cache.hits() > 0);
+}